@@ -0,0 +1,206 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+#ifndef __SIGFS_AGGREGATE__
+#define __SIGFS_AGGREGATE__
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "sigfs_common.h"
+#include "queue.hh"
+
+namespace sigfs {
+
+    //
+    // Windowed aggregation of a numeric field in the signals
+    // published to a queue.
+    //
+    // Queue::queue_signal() hands each payload to the aggregators
+    // added with Queue::add_aggregator(). Once a signal arrives in a
+    // new window, the aggregate of the previous window is published
+    // as a sigfs_aggregate_t to the target queue.
+    //
+    // Windows are aligned to multiples of the window length on the
+    // Queue::timestamp() clock. Windows with no signals produce no
+    // aggregate.
+    //
+    class Aggregator {
+    public:
+        enum class function_t { min, max, mean, sum };
+        enum class type_t { int8, int16, int32, int64, uint8, uint16, uint32, uint64, float32, float64 };
+
+        struct Config {
+            std::uint64_t window = 100000000; // Nanoseconds
+            function_t function = function_t::mean;
+            type_t type = type_t::float64;
+            std::uint32_t offset = 0;         // Payload offset of the field
+
+            // Parse a function / type name. Return false if name is unknown.
+            //
+            static bool parse_function(const std::string& name, function_t& res)
+            {
+                static const struct { const char* name; function_t function; } functions[] = {
+                    { "min", function_t::min },
+                    { "max", function_t::max },
+                    { "mean", function_t::mean },
+                    { "sum", function_t::sum }
+                };
+
+                for(auto& function: functions) {
+                    if (name == function.name) {
+                        res = function.function;
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            static bool parse_type(const std::string& name, type_t& res)
+            {
+                static const struct { const char* name; type_t type; } types[] = {
+                    { "int8", type_t::int8 },
+                    { "int16", type_t::int16 },
+                    { "int32", type_t::int32 },
+                    { "int64", type_t::int64 },
+                    { "uint8", type_t::uint8 },
+                    { "uint16", type_t::uint16 },
+                    { "uint32", type_t::uint32 },
+                    { "uint64", type_t::uint64 },
+                    { "float", type_t::float32 },
+                    { "double", type_t::float64 }
+                };
+
+                for(auto& type: types) {
+                    if (name == type.name) {
+                        res = type.type;
+                        return true;
+                    }
+                }
+                return false;
+            }
+        };
+
+        Aggregator(const Config& config, std::shared_ptr<Queue> target):
+            config_(config),
+            target_(target),
+            window_start_(0),
+            count_(0),
+            min_(0.0),
+            max_(0.0),
+            sum_(0.0)
+        {
+        }
+
+        // Add the field of a signal published at timestamp.
+        // Payloads too short to hold the field are ignored.
+        //
+        void add(const char* payload, const std::uint32_t payload_size, const std::uint64_t timestamp)
+        {
+            double value(0.0);
+
+            if (!read_value_(payload, payload_size, value))
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            const std::uint64_t window_start(timestamp - timestamp % config_.window);
+
+            // Signals published concurrently may arrive slightly out
+            // of order. Add late signals to the current window.
+            //
+            if (window_start > window_start_) {
+                if (count_)
+                    publish_();
+
+                window_start_ = window_start;
+                count_ = 0;
+            }
+
+            if (!count_ || value < min_)
+                min_ = value;
+
+            if (!count_ || value > max_)
+                max_ = value;
+
+            sum_ = count_?sum_ + value:value;
+            ++count_;
+        }
+
+    private:
+        // Publish the aggregate of the current window to target_.
+        // Called with mutex_ locked.
+        //
+        void publish_(void)
+        {
+            sigfs_aggregate_t res = {
+                .window_start = window_start_,
+                .count = count_,
+                .value = 0.0
+            };
+
+            switch(config_.function) {
+            case function_t::min: res.value = min_; break;
+            case function_t::max: res.value = max_; break;
+            case function_t::mean: res.value = sum_ / count_; break;
+            case function_t::sum: res.value = sum_; break;
+            }
+
+            // Never wait for readers of target_ here, since the
+            // signal being published to the source queue would wait
+            // with it.
+            target_->queue_signal((const char*) &res, sizeof(res), true);
+        }
+
+        template<typename T>
+        static inline double load_(const char* src)
+        {
+            T res;
+
+            memcpy(&res, src, sizeof(res));
+            return (double) res;
+        }
+
+        inline bool read_value_(const char* payload, const std::uint32_t payload_size, double& res) const
+        {
+            static constexpr std::uint32_t sizes[] = { 1, 2, 4, 8, 1, 2, 4, 8, 4, 8 };
+            const std::uint32_t size(sizes[(int) config_.type]);
+
+            if (payload_size < size || payload_size - size < config_.offset)
+                return false;
+
+            payload += config_.offset;
+
+            switch(config_.type) {
+            case type_t::int8: res = load_<std::int8_t>(payload); break;
+            case type_t::int16: res = load_<std::int16_t>(payload); break;
+            case type_t::int32: res = load_<std::int32_t>(payload); break;
+            case type_t::int64: res = load_<std::int64_t>(payload); break;
+            case type_t::uint8: res = load_<std::uint8_t>(payload); break;
+            case type_t::uint16: res = load_<std::uint16_t>(payload); break;
+            case type_t::uint32: res = load_<std::uint32_t>(payload); break;
+            case type_t::uint64: res = load_<std::uint64_t>(payload); break;
+            case type_t::float32: res = load_<float>(payload); break;
+            case type_t::float64: res = load_<double>(payload); break;
+            }
+            return true;
+        }
+
+        const Config config_;
+        std::shared_ptr<Queue> target_;
+
+        // Current window. Protected by mutex_.
+        std::mutex mutex_;
+        std::uint64_t window_start_;
+        std::uint32_t count_;
+        double min_;
+        double max_;
+        double sum_;
+    };
+}
+#endif // __SIGFS_AGGREGATE__
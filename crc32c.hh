@@ -0,0 +1,120 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+#ifndef __SIGFS_CRC32C__
+#define __SIGFS_CRC32C__
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace sigfs {
+
+    // CRC32C (Castagnoli) checksums, used to detect repeated payloads.
+    //
+    // Uses the SSE 4.2 crc32 instruction on x86-64 CPUs that have
+    // it, and the ARMv8 crc32c instructions when built for a CPU
+    // with the CRC extension. Other CPUs use a lookup table.
+    //
+    namespace crc32c_impl {
+        static constexpr std::uint32_t polynomial = 0x82F63B78; // Reflected
+
+        struct table_t {
+            std::uint32_t entry[256];
+
+            constexpr table_t(void): entry()
+            {
+                for(std::uint32_t ind = 0; ind < 256; ++ind) {
+                    std::uint32_t crc(ind);
+
+                    for(int bit = 0; bit < 8; ++bit)
+                        crc = (crc & 1)?(crc >> 1) ^ polynomial:(crc >> 1);
+
+                    entry[ind] = crc;
+                }
+            }
+        };
+
+        static constexpr table_t table;
+
+        static inline std::uint32_t soft(std::uint32_t crc, const char* data, std::size_t size)
+        {
+            while(size--)
+                crc = table.entry[(crc ^ (std::uint8_t) *data++) & 0xFF] ^ (crc >> 8);
+
+            return crc;
+        }
+
+#if defined(__x86_64__)
+        __attribute__((target("sse4.2")))
+        static inline std::uint32_t hard(std::uint32_t crc, const char* data, std::size_t size)
+        {
+            std::uint64_t crc64(crc);
+
+            for(; size >= sizeof(std::uint64_t); size -= sizeof(std::uint64_t)) {
+                std::uint64_t word;
+
+                memcpy(&word, data, sizeof(word));
+                crc64 = __builtin_ia32_crc32di(crc64, word);
+                data += sizeof(word);
+            }
+
+            crc = (std::uint32_t) crc64;
+            while(size--)
+                crc = __builtin_ia32_crc32qi(crc, (std::uint8_t) *data++);
+
+            return crc;
+        }
+
+        static inline bool have_hard(void)
+        {
+            static const bool res(__builtin_cpu_supports("sse4.2"));
+            return res;
+        }
+#elif defined(__ARM_FEATURE_CRC32)
+        static inline std::uint32_t hard(std::uint32_t crc, const char* data, std::size_t size)
+        {
+            for(; size >= sizeof(std::uint64_t); size -= sizeof(std::uint64_t)) {
+                std::uint64_t word;
+
+                memcpy(&word, data, sizeof(word));
+                crc = __crc32cd(crc, word);
+                data += sizeof(word);
+            }
+
+            while(size--)
+                crc = __crc32cb(crc, (std::uint8_t) *data++);
+
+            return crc;
+        }
+
+        static inline bool have_hard(void) { return true; }
+#else
+        static inline std::uint32_t hard(std::uint32_t crc, const char* data, std::size_t size)
+        {
+            return soft(crc, data, size);
+        }
+
+        static inline bool have_hard(void) { return false; }
+#endif
+    }
+
+    // Return the CRC32C of size bytes at data.
+    //
+    static inline std::uint32_t crc32c(const char* data, const std::size_t size)
+    {
+        if (crc32c_impl::have_hard())
+            return ~crc32c_impl::hard(~0U, data, size);
+
+        return ~crc32c_impl::soft(~0U, data, size);
+    }
+}
+#endif // __SIGFS_CRC32C__
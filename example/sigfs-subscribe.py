@@ -7,17 +7,24 @@ import getopt
 import sys
 import os
 import struct
+import fcntl
+import time
+
+# From sigfs_common.h
+SIGFS_READ_OPT_TIMESTAMP = 0x00000001
+SIGFS_IOC_SET_READ_OPTIONS = 0x4004F501 # _IOW(0xF5, 1, uint32_t)
 
 def usage(name):
-    print(f"Usage: {name} -f <signal-file>")
+    print(f"Usage: {name} -f <signal-file> [-t]")
     print("-f <signal-file>  The signal file to open and read from")
+    print("-t                Print the publish timestamp and delivery latency of each signal")
 
 if __name__ == "__main__":
     try:
         options, remainder = getopt.getopt(
             sys.argv[1:],
-            'f:',
-            ['file='])
+            'f:t',
+            ['file=', 'timestamp'])
 
     except getopt.GetoptError as err:
         print(err)
@@ -25,9 +32,12 @@ if __name__ == "__main__":
         sys.exit(1)
 
     fname = False
+    timestamp = False
     for opt, arg in options:
         if opt in ('-f', '--file'):
             fname = arg
+        elif opt in ('-t', '--timestamp'):
+            timestamp = True
         else:
             print("Unknown option: {}".format(opt))
             usage(sys.argv[0])
@@ -44,21 +54,31 @@ if __name__ == "__main__":
     # The format of the read data will be:
     # uint32: Number of signals lost since last read
     # uint64: Unique signal ID of the signal read.
+    # uint64: Publish timestamp, CLOCK_MONOTONIC nanoseconds (with -t only)
     # uint32: Length of signal payload
     # data:   Payload
     with open(fname, "rb") as f:
+        if timestamp:
+            fcntl.ioctl(f, SIGFS_IOC_SET_READ_OPTIONS, struct.pack("=I", SIGFS_READ_OPT_TIMESTAMP))
+
         print("Ctrl-c to exit")
         while True:
-            # Read signal header data
-            data = f.read(4+8+4)
-
-            # Unpack header
-            (lost_signals, signal_id, payload_size) = struct.unpack("=IQI", data)
+            if timestamp:
+                # Read and unpack signal header data
+                data = f.read(4+8+8+4)
+                (lost_signals, signal_id, publish_time, payload_size) = struct.unpack("=IQQI", data)
+                latency = time.clock_gettime_ns(time.CLOCK_MONOTONIC) - publish_time
+            else:
+                data = f.read(4+8+4)
+                (lost_signals, signal_id, payload_size) = struct.unpack("=IQI", data)
 
             # Read remaining payload
             payload = f.read(payload_size)
 
-            print(f"lost-signals: {lost_signals}  signal-id: {signal_id}  payload-size: {payload_size}  payload: {payload.decode('ascii')}")
+            if timestamp:
+                print(f"lost-signals: {lost_signals}  signal-id: {signal_id}  publish-time: {publish_time}  latency-nsec: {latency}  payload-size: {payload_size}  payload: {payload.decode('ascii')}")
+            else:
+                print(f"lost-signals: {lost_signals}  signal-id: {signal_id}  payload-size: {payload_size}  payload: {payload.decode('ascii')}")
 
 
 
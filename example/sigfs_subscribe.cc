@@ -22,15 +22,18 @@
 #include <string.h>
 #include <errno.h>
 #include <cstdlib>
+#include <time.h>
 
 void usage(const char* name)
 {
     std::cout << "Usage: " << name << "-f <file> | --file=<file> " << std::endl;
     std::cout << "            [-c <signal-count> | --count=<signal-count>] " << std::endl;
-    std::cout << "            [-h | --hex]" << std::endl << std::endl;
+    std::cout << "            [-h | --hex]" << std::endl;
+    std::cout << "            [-t | --timestamp]" << std::endl << std::endl;
     std::cout << "-f <file>         The signal file to subscribe from." << std::endl;
     std::cout << "-c <signal-count> The number of signals to read before exiting. Default: 0=infinite." << std::endl;
     std::cout << "-h                Print data in hex. Default is to print escaped strings." << std::endl;
+    std::cout << "-t                Print the publish timestamp and delivery latency of each signal." << std::endl;
 }
 
 
@@ -105,14 +108,16 @@ int main(int argc,  char *const* argv)
         {"file", required_argument, NULL, 'f'},
         {"count", optional_argument, NULL, 'c'},
         {"hex", optional_argument, NULL, 'h'},
+        {"timestamp", optional_argument, NULL, 't'},
         {NULL, 0, NULL, 0}
     };
     std::string file{""};
     bool hex{false};
+    bool timestamp{false};
     int count = 0;
     int fd{-1};
     // loop over all of the options
-    while ((ch = getopt_long(argc, argv, "c:f:h", long_options, NULL)) != -1) {
+    while ((ch = getopt_long(argc, argv, "c:f:ht", long_options, NULL)) != -1) {
         // check to see if a single character or long option came through
         switch (ch)
         {
@@ -128,6 +133,10 @@ int main(int argc,  char *const* argv)
             hex=true;
             break;
 
+        case 't':
+            timestamp=true;
+            break;
+
         default:
             usage(argv[0]);
             exit(255);
@@ -147,6 +156,16 @@ int main(int argc,  char *const* argv)
         exit(255);
     }
 
+    // Have the publish timestamp added to each signal header.
+    if (timestamp) {
+        uint32_t read_options = SIGFS_READ_OPT_TIMESTAMP;
+
+        if (ioctl(fd, SIGFS_IOC_SET_READ_OPTIONS, &read_options) == -1) {
+            std::cout << "Could not enable timestamps on " << file << ": " << strerror(errno) << std::endl;
+            exit(255);
+        }
+    }
+
     char buf[65536];
     char esc_buf[sizeof(buf)*4];
     int ind = 0;
@@ -155,7 +174,10 @@ int main(int argc,  char *const* argv)
     else
         std::cout << "Reading signals. Ctrl-c to abort" << std::endl;
 
-    puts("id, signals-lost, size, data");
+    if (timestamp)
+        puts("id, signals-lost, publish-time-nsec, latency-nsec, size, data");
+    else
+        puts("id, signals-lost, size, data");
 
     while(!count || ind < count) {
         ssize_t read_res = read(fd, buf, sizeof(buf));
@@ -165,6 +187,32 @@ int main(int argc,  char *const* argv)
             exit(255);
         }
 
+        while(read_res && timestamp) {
+            sigfs_signal_ts_t *sig((sigfs_signal_ts_t*) (buf + offset));
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            printf("%lu, %u, %lu, %lu, %u, \"%s\"\n",
+                   sig->signal_id,
+                   sig->lost_signals,
+                   sig->publish_time,
+                   (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec - sig->publish_time,
+                   sig->payload.payload_size,
+                   hex?
+                   hex_string(esc_buf,
+                              sizeof(esc_buf),
+                              sig->payload.payload,
+                              sig->payload.payload_size):
+                   escape_string(esc_buf,
+                                 sizeof(esc_buf),
+                                 sig->payload.payload,
+                                 sig->payload.payload_size));
+
+            read_res -= SIGFS_SIGNAL_TS_SIZE(sig);
+            offset += SIGFS_SIGNAL_TS_SIZE(sig);
+        }
+
         while(read_res) {
             sigfs_signal_t *sig((sigfs_signal_t*) (buf + offset));
 
@@ -0,0 +1,208 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+#ifndef __SIGFS_FILTER__
+#define __SIGFS_FILTER__
+#include <cstdint>
+#include <cstring>
+#include "sigfs_common.h"
+
+namespace sigfs {
+
+    // Subscriber filter, as installed by SIGFS_IOC_SET_FILTER.
+    //
+    // Each predicate is evaluated as a single 64 bit masked compare
+    // of up to eight payload bytes. Bytes beyond the predicate size
+    // are masked out when the filter is installed, so the compare
+    // can load eight bytes whenever the payload is long enough.
+    //
+    class SignalFilter {
+    public:
+        SignalFilter(void):
+            count_(0)
+        {
+        }
+
+        inline bool empty(void) const { return !count_; }
+
+        // Install filter. Return false, leaving the current
+        // predicates in place, if filter is invalid.
+        //
+        bool set(const sigfs_filter_t& filter)
+        {
+            if (filter.predicate_count > SIGFS_FILTER_MAX_PREDICATES || filter.reserved)
+                return false;
+
+            for(std::uint32_t ind = 0; ind < filter.predicate_count; ++ind) {
+                const sigfs_filter_predicate_t& pred(filter.predicates[ind]);
+
+                if (pred.size < 1 || pred.size > 8 || pred.offset > UINT32_MAX - pred.size)
+                    return false;
+            }
+
+            for(std::uint32_t ind = 0; ind < filter.predicate_count; ++ind) {
+                const sigfs_filter_predicate_t& pred(filter.predicates[ind]);
+                const std::uint64_t size_mask((pred.size == 8)?~0ULL:((1ULL << (8 * pred.size)) - 1));
+
+                predicates_[ind] = {
+                    .end = pred.offset + pred.size,
+                    .offset = pred.offset,
+                    .mask = pred.mask & size_mask,
+                    .value = pred.value & pred.mask & size_mask
+                };
+            }
+
+            count_ = filter.predicate_count;
+            return true;
+        }
+
+        // Retrieve the installed filter. Masks and values are
+        // limited to the predicate sizes.
+        //
+        void get(sigfs_filter_t& res) const
+        {
+            memset(&res, 0, sizeof(res));
+            res.predicate_count = count_;
+
+            for(std::uint32_t ind = 0; ind < count_; ++ind) {
+                res.predicates[ind] = {
+                    .offset = predicates_[ind].offset,
+                    .size = predicates_[ind].end - predicates_[ind].offset,
+                    .mask = predicates_[ind].mask,
+                    .value = predicates_[ind].value
+                };
+            }
+        }
+
+        // Return true if the payload matches all predicates, or if
+        // the filter is empty.
+        //
+        inline bool match(const char* payload, const std::uint32_t payload_size) const
+        {
+            for(std::uint32_t ind = 0; ind < count_; ++ind) {
+                const predicate_t& pred(predicates_[ind]);
+                std::uint64_t word(0);
+
+                if (payload_size < pred.end)
+                    return false;
+
+                // Load a full word when it fits in the payload, which
+                // lets the compiler use a single 64 bit load.
+                if (payload_size - pred.offset >= sizeof(word))
+                    memcpy(&word, payload + pred.offset, sizeof(word));
+                else
+                    memcpy(&word, payload + pred.offset, pred.end - pred.offset);
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                word = __builtin_bswap64(word);
+#endif
+                if ((word & pred.mask) != pred.value)
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        struct predicate_t {
+            std::uint32_t end;    // offset + size
+            std::uint32_t offset;
+            std::uint64_t mask;   // Limited to size bytes.
+            std::uint64_t value;  // Masked with mask.
+        };
+
+        std::uint32_t count_;
+        predicate_t predicates_[SIGFS_FILTER_MAX_PREDICATES];
+    };
+
+
+    // Subscriber rate limit, as installed by SIGFS_IOC_SET_RATE.
+    //
+    class DeliveryRate {
+    public:
+        // Where the next signal to deliver can be found, given the
+        // last signal delivered.
+        //
+        struct state_t {
+            signal_id_t next_id = 0;      // Skip signals before this one.
+            std::uint64_t next_time = 0;  // Hold back signals until this time.
+        };
+
+        inline bool empty(void) const { return decimation_ < 2 && !min_interval_; }
+
+        inline std::uint32_t decimation(void) const { return decimation_; }
+        inline std::uint64_t min_interval(void) const { return min_interval_; }
+
+        // Install rate limit. Return false if rate is invalid.
+        //
+        bool set(const sigfs_rate_t& rate)
+        {
+            if (rate.reserved)
+                return false;
+
+            decimation_ = rate.decimation;
+            min_interval_ = rate.min_interval_nsec;
+            return true;
+        }
+
+        void get(sigfs_rate_t& res) const
+        {
+            memset(&res, 0, sizeof(res));
+            res.decimation = decimation_;
+            res.min_interval_nsec = min_interval_;
+        }
+
+        // Return the state after signal_id has been delivered at
+        // delivery_time.
+        //
+        inline state_t next(const signal_id_t signal_id, const std::uint64_t delivery_time) const
+        {
+            return state_t {
+                .next_id = (decimation_ > 1)?signal_id + decimation_:0,
+                .next_time = min_interval_?delivery_time + min_interval_:0
+            };
+        }
+
+    private:
+        std::uint32_t decimation_ = 0;
+        std::uint64_t min_interval_ = 0;
+    };
+
+
+    // Subscriber lag policy, as installed by SIGFS_IOC_SET_LAG.
+    //
+    class LagPolicy {
+    public:
+        inline bool empty(void) const { return !max_lag_; }
+
+        inline std::uint32_t max_lag(void) const { return max_lag_; }
+        inline std::uint32_t keep(void) const { return keep_; }
+
+        // Install lag policy. Return false if lag is invalid.
+        //
+        bool set(const sigfs_lag_t& lag)
+        {
+            if (lag.max_lag && (!lag.keep || lag.keep > lag.max_lag))
+                return false;
+
+            max_lag_ = lag.max_lag;
+            keep_ = lag.max_lag?lag.keep:0;
+            return true;
+        }
+
+        void get(sigfs_lag_t& res) const
+        {
+            res.max_lag = max_lag_;
+            res.keep = keep_;
+        }
+
+    private:
+        std::uint32_t max_lag_ = 0;
+        std::uint32_t keep_ = 0;
+    };
+}
+#endif // __SIGFS_FILTER__
@@ -11,6 +11,7 @@
 #include "sigfs_common.h"
 #include <unistd.h>
 #include <sys/types.h>
+#include <sched.h>
 #include <map>
 #include <exception>
 #include <nlohmann/json.hpp>
@@ -18,6 +19,7 @@
 #include <iostream>
 #include <variant>
 #include "queue.hh"
+#include "aggregate.hh"
 #include <mutex>
 
 using json=nlohmann::json;
@@ -128,10 +130,10 @@ namespace sigfs {
             virtual ~INode(void) {}
             virtual json to_config(void) const;
 
-            void get_access(uid_t uid,
-                            gid_t gid,
-                            bool& can_read,
-                            bool& can_write);
+            virtual void get_access(uid_t uid,
+                                    gid_t gid,
+                                    bool& can_read,
+                                    bool& can_write);
 
             std::shared_ptr<INode> parent_entry(void);
             const ino_t inode(void) const;
@@ -176,6 +178,48 @@ namespace sigfs {
 
             std::shared_ptr<Queue> queue(void);
 
+            // Return the queue if it has been created by a previous
+            // call to queue(), or nullptr if it has not.
+            std::shared_ptr<Queue> existing_queue(void) const;
+
+            const Queue::index_t queue_length(void) const;
+
+            // Sync and storage policies of the queue.
+            const Queue::Config& queue_config(void) const;
+
+            // CPUs that FUSE worker threads are pinned to while
+            // serving the file, or nullptr if not configured.
+            const cpu_set_t* worker_cpus(void) const;
+
+            // Default SIGFS_READ_OPT_* bitmask for file descriptors
+            // opened on the file.
+            const uint32_t read_options(void) const;
+
+            // Shortest time, in nanoseconds, between two poll
+            // notifications sent to a file descriptor opened on the
+            // file. 0 if not limited.
+            const std::uint64_t poll_interval(void) const;
+
+            // Derived files are declared with an "aggregate" object
+            // and receive the aggregates of another file's signals.
+            // They cannot be written to.
+            //
+            bool is_derived(void) const;
+
+            // The "source" of a derived file's "aggregate" object.
+            const std::string& aggregate_source(void) const;
+
+            const Aggregator::Config& aggregate_config(void) const;
+
+            // Publish aggregates of the file's signals to derived
+            // once the queue is created.
+            void add_derived(std::shared_ptr<File> derived);
+
+            virtual void get_access(uid_t uid,
+                                    gid_t gid,
+                                    bool& can_read,
+                                    bool& can_write);
+
             static bool is_file(INode* obj) {
                 return (dynamic_cast<File*>(obj) != nullptr);
             }
@@ -187,11 +231,109 @@ namespace sigfs {
             static constexpr uint32_t DEFAULT_QUEUE_LENGTH = 16777216; // 16 MB.
         private:
             const Queue::index_t queue_length_;
+            const Queue::Config queue_config_;
+            cpu_set_t worker_cpus_;
+            const uint32_t read_options_;
+            const std::uint64_t poll_interval_;
+            std::string aggregate_source_;
+            Aggregator::Config aggregate_config_;
+            std::vector<std::shared_ptr<File>> derived_;
             std::shared_ptr<Queue> queue_;
             mutable std::mutex mutex_; // Used to guard queue creation in queue() call.
         };
 
 
+        // Virtual file reporting the queue statistics of a
+        // signal file. For every signal file "x" in a directory, two
+        // statistics files are created alongside it:
+        //
+        //   "x.stats"      - Statistics in "key: value" text format.
+        //   "x.stats.json" - Statistics in JSON format.
+        //
+        // Access rights are inherited from the signal file. Readers
+        // and writers of the signal file can read the statistics, and
+        // writers can reset the latency histogram by writing to it.
+        //
+        // Set "stats": false in a file object to disable its
+        // statistics files.
+        //
+        class StatsFile: public INode {
+        public:
+            enum class format_t { text, json };
+
+            StatsFile(FileSystem& owner,
+                      const ino_t parent_inode,
+                      std::shared_ptr<File> file,
+                      const format_t format);
+
+            virtual void get_access(uid_t uid,
+                                    gid_t gid,
+                                    bool& can_read,
+                                    bool& can_write);
+
+            // Render the current statistics of the signal file.
+            std::string content(void) const;
+
+            // Reset the latency histogram of the signal file.
+            void reset(void);
+
+            static bool is_stats_file(INode* obj) {
+                return (dynamic_cast<StatsFile*>(obj) != nullptr);
+            }
+
+            static bool is_stats_file(std::shared_ptr<INode> obj) {
+                return (std::dynamic_pointer_cast<StatsFile>(obj) != nullptr);
+            }
+
+            static const char* suffix(const format_t format);
+
+        private:
+            json to_json(const Queue::Stats& stats) const;
+            std::string to_text(const Queue::Stats& stats) const;
+
+            std::shared_ptr<File> file_;
+            const format_t format_;
+        };
+
+
+        // Virtual file delivering the signals of all signal files in
+        // a directory and its subdirectories as a single stream,
+        // ordered by publish time. See MergedSubscriber in merge.hh.
+        //
+        // Created with "merge_file": "<name>" in a directory object.
+        // Each signal is returned as a sigfs_merged_signal_t, which
+        // identifies its signal file by inode.
+        //
+        // Merge files are read only. They can be read by those
+        // who can read every signal file merged.
+        //
+        class MergeFile: public INode {
+        public:
+            MergeFile(FileSystem& owner,
+                      const ino_t parent_inode,
+                      const std::string& name,
+                      const std::vector<std::shared_ptr<File>>& files);
+
+            virtual void get_access(uid_t uid,
+                                    gid_t gid,
+                                    bool& can_read,
+                                    bool& can_write);
+
+            const std::vector<std::shared_ptr<File>>& files(void) const;
+
+            static bool is_merge_file(INode* obj) {
+                return (dynamic_cast<MergeFile*>(obj) != nullptr);
+            }
+
+            static bool is_merge_file(std::shared_ptr<INode> obj) {
+                return (std::dynamic_pointer_cast<MergeFile>(obj) != nullptr);
+            }
+
+        private:
+            const std::vector<std::shared_ptr<File>> files_;
+        };
+
+
         class Directory: public INode {
         public:
             Directory(FileSystem& owner, const ino_t parent_inode, const json &config);
@@ -200,6 +342,10 @@ namespace sigfs {
             std::shared_ptr<INode> lookup_entry(const std::string& name) const;
             void for_each_entry(std::function<void(std::shared_ptr<INode>)>) const;
 
+            // Call callback with every signal file in the directory
+            // and its subdirectories.
+            void for_each_file(std::function<void(std::shared_ptr<File>)> callback) const;
+
             static bool is_directory(INode* obj) {
                 return (dynamic_cast<Directory*>(obj) != nullptr);
             }
@@ -214,6 +360,7 @@ namespace sigfs {
                 json to_config(void) const;
             };
             Entries entries_;
+            std::string merge_file_;
         };
 
     public:
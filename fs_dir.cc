@@ -25,6 +25,14 @@ FileSystem::Directory::Directory(FileSystem& owner, const ino_t parent_inode, co
     for(auto entry: config["entries"]) {
         const std::string name(entry["name"]);
 
+        // Also catches a file named after the stats file of an
+        // earlier file.
+        if (lookup_entry(name)) {
+            SIGFS_LOG_FATAL("Directory %s: Entry \"%s\" is already in the directory.",
+                            this->name().c_str(), name.c_str());
+            exit(255);
+        }
+
         // Anything with an "entries" element is a directory.
         if (entry.contains("entries")) {
             auto new_dir = std::make_shared<Directory>(owner, inode(), entry);
@@ -35,7 +43,69 @@ FileSystem::Directory::Directory(FileSystem& owner, const ino_t parent_inode, co
             auto new_file = std::make_shared<File>(owner, inode(), entry);
             entries_.insert(std::pair (name, new_file));
             owner.register_inode(new_file);
+
+            if (entry.value("stats", true)) {
+                for(auto format: { StatsFile::format_t::text, StatsFile::format_t::json }) {
+                    auto stats_file = std::make_shared<StatsFile>(owner, inode(), new_file, format);
+
+                    if (lookup_entry(stats_file->name())) {
+                        SIGFS_LOG_FATAL("File %s: Stats file \"%s\" is already an entry in the directory.",
+                                        name.c_str(), stats_file->name().c_str());
+                        exit(255);
+                    }
+
+                    entries_.insert(std::pair (stats_file->name(), stats_file));
+                    owner.register_inode(stats_file);
+                }
+            }
+        }
+    }
+
+    // Connect derived files to their source files, which are
+    // looked up in the same directory.
+    //
+    for(auto& entry: entries_) {
+        auto derived(std::dynamic_pointer_cast<File>(entry.second));
+
+        if (!derived || !derived->is_derived())
+            continue;
+
+        auto source(std::dynamic_pointer_cast<File>(lookup_entry(derived->aggregate_source())));
+
+        if (!source) {
+            SIGFS_LOG_FATAL("File %s: Aggregate source \"%s\" is not a file in the same directory.",
+                            derived->name().c_str(), derived->aggregate_source().c_str());
+            exit(255);
+        }
+
+        if (source->is_derived()) {
+            SIGFS_LOG_FATAL("File %s: Aggregate source \"%s\" is itself a derived file.",
+                            derived->name().c_str(), derived->aggregate_source().c_str());
+            exit(255);
+        }
+
+        source->add_derived(derived);
+    }
+
+    // Subdirectories are complete at this point, so the merge file
+    // picks up the signal files of the entire subtree.
+    //
+    if (config.contains("merge_file")) {
+        merge_file_ = config["merge_file"];
+
+        if (lookup_entry(merge_file_)) {
+            SIGFS_LOG_FATAL("Directory %s: Merge file \"%s\" is already an entry in the directory.",
+                            name().c_str(), merge_file_.c_str());
+            exit(255);
         }
+
+        std::vector<std::shared_ptr<File>> files;
+
+        for_each_file([&files](std::shared_ptr<File> file) { files.push_back(file); });
+
+        auto merge_file = std::make_shared<MergeFile>(owner, inode(), merge_file_, files);
+        entries_.insert(std::pair (merge_file_, merge_file));
+        owner.register_inode(merge_file);
     }
 }
 
@@ -45,6 +115,9 @@ json FileSystem::Directory::to_config(void) const
 {
     json res(INode::to_config());
 
+    if (!merge_file_.empty())
+        res["merge_file"] = merge_file_;
+
     res["entries"] = entries_.to_config();
     return res;
 }
@@ -55,6 +128,10 @@ json FileSystem::Directory::Entries::to_config(void) const
 
     // There is probably a more elegant way of doing this.
     for(auto& elem: *this) {
+        // Statistics and merge files are generated, not configured.
+        if (StatsFile::is_stats_file(elem.second) || MergeFile::is_merge_file(elem.second))
+            continue;
+
         lst.push_back(elem.second->to_config());
     }
 
@@ -86,3 +163,14 @@ void FileSystem::Directory::for_each_entry(std::function<void(std::shared_ptr<IN
     std::for_each(entries_.begin(), entries_.end(),internal_callback);
     return;
 }
+
+
+void FileSystem::Directory::for_each_file(std::function<void(std::shared_ptr<File>)> callback) const
+{
+    for(auto& entry: entries_) {
+        if (File::is_file(entry.second))
+            callback(std::dynamic_pointer_cast<File>(entry.second));
+        else if (is_directory(entry.second))
+            std::dynamic_pointer_cast<Directory>(entry.second)->for_each_file(callback);
+    }
+}
@@ -11,25 +11,230 @@
 #include "log.h"
 using namespace sigfs;
 
+// Read the queue_sync, queue_storage, slot_size, huge_pages, mlock,
+// numa_node, on_change, overflow, and overflow_timeout_msec
+// properties of a file object.
+static Queue::Config read_queue_config(const json& config)
+{
+    Queue::Config res;
+    const std::string name(config.value("name", ""));
+    const std::string sync(config.value("queue_sync", res.sync_name()));
+    const std::string storage(config.value("queue_storage", res.storage_name()));
+    const std::string overflow(config.value("overflow", res.overflow_name()));
+    const std::uint64_t overflow_timeout_msec(config.value("overflow_timeout_msec", (std::uint64_t) 100));
+
+    if (!Queue::Config::parse_sync(sync, res.sync)) {
+        SIGFS_LOG_FATAL("File %s: Unknown queue_sync \"%s\". Use \"mutex\" or \"spin\".",
+                        name.c_str(), sync.c_str());
+        exit(255);
+    }
+
+    if (!Queue::Config::parse_storage(storage, res.storage)) {
+        SIGFS_LOG_FATAL("File %s: Unknown queue_storage \"%s\". Use \"heap\", \"arena\", or \"inline\".",
+                        name.c_str(), storage.c_str());
+        exit(255);
+    }
+
+    if (!Queue::Config::parse_overflow(overflow, res.overflow)) {
+        SIGFS_LOG_FATAL("File %s: Unknown overflow \"%s\". Use \"overwrite\", \"block\", or \"eagain\".",
+                        name.c_str(), overflow.c_str());
+        exit(255);
+    }
+
+    if (!overflow_timeout_msec) {
+        SIGFS_LOG_FATAL("File %s: overflow_timeout_msec must be greater than 0.", name.c_str());
+        exit(255);
+    }
+
+    res.overflow_timeout = overflow_timeout_msec * 1000000;
+    res.slot_size = config.value("slot_size", res.slot_size);
+    res.memory.huge_pages = config.value("huge_pages", res.memory.huge_pages);
+    res.memory.lock = config.value("mlock", res.memory.lock);
+    res.memory.numa_node = config.value("numa_node", res.memory.numa_node);
+    res.on_change = config.value("on_change", res.on_change);
+    return res;
+}
+
+// Read the "aggregate" object of a derived file. Return the
+// source file name in source.
+//
+static Aggregator::Config read_aggregate_config(const json& config, std::string& source)
+{
+    Aggregator::Config res;
+    const std::string name(config.value("name", ""));
+    const json& aggregate(config["aggregate"]);
+    const std::string function(aggregate.value("function", "mean"));
+    const std::string type(aggregate.value("type", "double"));
+    const std::uint64_t window_msec(aggregate.value("window_msec", (std::uint64_t) 100));
+
+    source = aggregate.value("source", "");
+
+    if (source.empty()) {
+        SIGFS_LOG_FATAL("File %s: Missing aggregate source.", name.c_str());
+        exit(255);
+    }
+
+    if (!Aggregator::Config::parse_function(function, res.function)) {
+        SIGFS_LOG_FATAL("File %s: Unknown aggregate function \"%s\". Use \"min\", \"max\", \"mean\", or \"sum\".",
+                        name.c_str(), function.c_str());
+        exit(255);
+    }
+
+    if (!Aggregator::Config::parse_type(type, res.type)) {
+        SIGFS_LOG_FATAL("File %s: Unknown aggregate type \"%s\". Use \"int8\" - \"int64\", \"uint8\" - \"uint64\", \"float\", or \"double\".",
+                        name.c_str(), type.c_str());
+        exit(255);
+    }
+
+    if (!window_msec) {
+        SIGFS_LOG_FATAL("File %s: aggregate window_msec must be greater than 0.", name.c_str());
+        exit(255);
+    }
+
+    res.window = window_msec * 1000000;
+    res.offset = aggregate.value("offset", res.offset);
+    return res;
+}
+
+// Parse a CPU list, such as "0-3,8", into res.
+static bool parse_cpu_list(const std::string& list, cpu_set_t& res)
+{
+    const char* cur(list.c_str());
+
+    CPU_ZERO(&res);
+    while(*cur) {
+        char* end(nullptr);
+        long first(strtol(cur, &end, 10));
+        long last(first);
+
+        if (end == cur || first < 0)
+            return false;
+
+        if (*end == '-') {
+            cur = end + 1;
+            last = strtol(cur, &end, 10);
+
+            if (end == cur || last < first)
+                return false;
+        }
+
+        if (last >= CPU_SETSIZE)
+            return false;
+
+        for(long cpu = first; cpu <= last; ++cpu)
+            CPU_SET(cpu, &res);
+
+        if (*end == ',')
+            ++end;
+        else if (*end)
+            return false;
+
+        cur = end;
+    }
+
+    return CPU_COUNT(&res) > 0;
+}
+
 FileSystem::File::File(FileSystem& owner, const ino_t parent_inode, const json& config):
     INode(owner, parent_inode, config),
     queue_length_(config.value("queue_length", FileSystem::File::DEFAULT_QUEUE_LENGTH)),
+    queue_config_(read_queue_config(config)),
+    read_options_(config.value("timestamp", false)?SIGFS_READ_OPT_TIMESTAMP:0),
+    poll_interval_(config.value("poll_interval_usec", (std::uint64_t) 0) * 1000),
     queue_(nullptr)
 {
+    const std::string cpus(config.value("worker_cpus", ""));
+
+    CPU_ZERO(&worker_cpus_);
+    if (!cpus.empty() && !parse_cpu_list(cpus, worker_cpus_)) {
+        SIGFS_LOG_FATAL("File %s: Invalid worker_cpus \"%s\". Use a CPU list such as \"0-3,8\".",
+                        name().c_str(), cpus.c_str());
+        exit(255);
+    }
+
+    if (config.contains("aggregate"))
+        aggregate_config_ = read_aggregate_config(config, aggregate_source_);
 }
 
 std::shared_ptr<Queue> FileSystem::File::queue(void)
 {
     std::lock_guard<std::mutex> lock(mutex_);
     if (queue_ == nullptr) {
-        queue_ = std::make_shared<Queue>(queue_length_);
+        queue_ = std::make_shared<Queue>(queue_length_, inode(), queue_config_);
         if (queue_ == nullptr) {
             SIGFS_LOG_FATAL("FileSystem::File::queue(): Could not create queue with lenght %u", queue_length_);
             abort();
         }
+
+        for(auto& derived: derived_)
+            queue_->add_aggregator(std::make_shared<Aggregator>(derived->aggregate_config(), derived->queue()));
     }
     return queue_;
 }
 
+std::shared_ptr<Queue> FileSystem::File::existing_queue(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_;
+}
+
+const Queue::index_t FileSystem::File::queue_length(void) const
+{
+    return queue_length_;
+}
+
+const Queue::Config& FileSystem::File::queue_config(void) const
+{
+    return queue_config_;
+}
+
+const cpu_set_t* FileSystem::File::worker_cpus(void) const
+{
+    return CPU_COUNT(&worker_cpus_)?&worker_cpus_:nullptr;
+}
+
+const uint32_t FileSystem::File::read_options(void) const
+{
+    return read_options_;
+}
+
+const std::uint64_t FileSystem::File::poll_interval(void) const
+{
+    return poll_interval_;
+}
+
+bool FileSystem::File::is_derived(void) const
+{
+    return !aggregate_source_.empty();
+}
+
+const std::string& FileSystem::File::aggregate_source(void) const
+{
+    return aggregate_source_;
+}
+
+const Aggregator::Config& FileSystem::File::aggregate_config(void) const
+{
+    return aggregate_config_;
+}
+
+void FileSystem::File::add_derived(std::shared_ptr<File> derived)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    derived_.push_back(derived);
+}
+
+void FileSystem::File::get_access(uid_t uid,
+                                  gid_t gid,
+                                  bool& can_read,
+                                  bool& can_write)
+{
+    INode::get_access(uid, gid, can_read, can_write);
+
+    // Derived files are only written by their aggregator.
+    if (is_derived())
+        can_write = false;
+}
+
 
 
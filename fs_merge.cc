@@ -0,0 +1,50 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+
+#include "fs.hh"
+#include "log.h"
+
+using namespace sigfs;
+
+FileSystem::MergeFile::MergeFile(FileSystem& owner,
+                                 const ino_t parent_inode,
+                                 const std::string& name,
+                                 const std::vector<std::shared_ptr<File>>& files):
+    INode(owner, parent_inode, json( { { "name", name } } )),
+    files_(files)
+{
+}
+
+void FileSystem::MergeFile::get_access(uid_t uid,
+                                       gid_t gid,
+                                       bool& can_read,
+                                       bool& can_write)
+{
+    // The merged stream reveals the signals of every file, so all
+    // of them must be readable.
+    can_read = !files_.empty();
+    can_write = false;
+
+    for(auto& file: files_) {
+        bool file_can_read(false);
+        bool file_can_write(false);
+
+        file->get_access(uid, gid, file_can_read, file_can_write);
+
+        if (!file_can_read) {
+            can_read = false;
+            return;
+        }
+    }
+}
+
+const std::vector<std::shared_ptr<FileSystem::File>>& FileSystem::MergeFile::files(void) const
+{
+    return files_;
+}
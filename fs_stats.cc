@@ -0,0 +1,151 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+
+#include "fs.hh"
+#include "log.h"
+#include <sstream>
+
+using namespace sigfs;
+
+FileSystem::StatsFile::StatsFile(FileSystem& owner,
+                                 const ino_t parent_inode,
+                                 std::shared_ptr<File> file,
+                                 const format_t format):
+    INode(owner, parent_inode, json( { { "name", file->name() + suffix(format) } } )),
+    file_(file),
+    format_(format)
+{
+}
+
+const char* FileSystem::StatsFile::suffix(const format_t format)
+{
+    return (format == format_t::json)?".stats.json":".stats";
+}
+
+void FileSystem::StatsFile::get_access(uid_t uid,
+                                       gid_t gid,
+                                       bool& can_read,
+                                       bool& can_write)
+{
+    // Anyone who can access the signal file can read its statistics.
+    // Publishers can reset them.
+    bool file_can_read(false);
+    bool file_can_write(false);
+
+    file_->get_access(uid, gid, file_can_read, file_can_write);
+    can_read = file_can_read || file_can_write;
+    can_write = file_can_write;
+}
+
+void FileSystem::StatsFile::reset(void)
+{
+    auto queue = file_->existing_queue();
+
+    if (queue)
+        queue->delivery_latency().reset();
+}
+
+std::string FileSystem::StatsFile::content(void) const
+{
+    auto queue = file_->existing_queue();
+    Queue::Stats stats {};
+
+    // If no one has opened the file yet, there is no queue and
+    // nothing to report except for the configured queue length.
+    //
+    if (queue)
+        stats = queue->statistics();
+    else
+        stats.queue_length = file_->queue_length();
+
+    if (format_ == format_t::json)
+        return to_json(stats).dump(4) + "\n";
+
+    return to_text(stats);
+}
+
+// Share of the signals written to the file that were dropped by
+// on_change, from 0.0 to 1.0.
+//
+static double suppression_ratio(const Queue::Stats& stats)
+{
+    const std::uint64_t total(stats.signals_published + stats.signals_suppressed);
+
+    return total?(double) stats.signals_suppressed / total:0.0;
+}
+
+json FileSystem::StatsFile::to_json(const Queue::Stats& stats) const
+{
+    json subscribers = json::array();
+
+    for(auto& sub: stats.subscribers) {
+        subscribers.push_back(json( {
+                    { "sub_id", sub.sub_id },
+                    { "signals_delivered", sub.signals_delivered },
+                    { "signals_lost", sub.signals_lost },
+                    { "signals_filtered", sub.signals_filtered },
+                    { "signals_skipped", sub.signals_skipped },
+                    { "lag", sub.lag }
+                } ));
+    }
+
+    return json( {
+            { "name", file_->name() },
+            { "queue_length", stats.queue_length },
+            { "signals_published", stats.signals_published },
+            { "bytes_published", stats.bytes_published },
+            { "signals_lost", stats.signals_lost },
+            { "signals_suppressed", stats.signals_suppressed },
+            { "signals_rejected", stats.signals_rejected },
+            { "suppression_ratio", suppression_ratio(stats) },
+            { "peak_occupancy", stats.peak_occupancy },
+            { "latency_nsec", {
+                    { "count", stats.latency.count },
+                    { "mean", stats.latency.mean },
+                    { "p50", stats.latency.p50 },
+                    { "p99", stats.latency.p99 },
+                    { "p99.9", stats.latency.p999 },
+                    { "max", stats.latency.max }
+                } },
+            { "subscribers", subscribers }
+        } );
+}
+
+std::string FileSystem::StatsFile::to_text(const Queue::Stats& stats) const
+{
+    std::ostringstream res;
+
+    res << "name: " << file_->name() << std::endl
+        << "queue_length: " << stats.queue_length << std::endl
+        << "signals_published: " << stats.signals_published << std::endl
+        << "bytes_published: " << stats.bytes_published << std::endl
+        << "signals_lost: " << stats.signals_lost << std::endl
+        << "signals_suppressed: " << stats.signals_suppressed << std::endl
+        << "signals_rejected: " << stats.signals_rejected << std::endl
+        << "suppression_ratio: " << suppression_ratio(stats) << std::endl
+        << "peak_occupancy: " << stats.peak_occupancy << std::endl
+        << "latency_count: " << stats.latency.count << std::endl
+        << "latency_mean_nsec: " << stats.latency.mean << std::endl
+        << "latency_p50_nsec: " << stats.latency.p50 << std::endl
+        << "latency_p99_nsec: " << stats.latency.p99 << std::endl
+        << "latency_p99.9_nsec: " << stats.latency.p999 << std::endl
+        << "latency_max_nsec: " << stats.latency.max << std::endl
+        << "subscribers: " << stats.subscribers.size() << std::endl;
+
+    for(auto& sub: stats.subscribers) {
+        res << "subscriber[" << sub.sub_id << "]:"
+            << " signals_delivered: " << sub.signals_delivered
+            << " signals_lost: " << sub.signals_lost
+            << " signals_filtered: " << sub.signals_filtered
+            << " signals_skipped: " << sub.signals_skipped
+            << " lag: " << sub.lag << std::endl;
+    }
+
+    return res.str();
+}
@@ -0,0 +1,158 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+#ifndef __SIGFS_HISTOGRAM__
+#define __SIGFS_HISTOGRAM__
+#include <atomic>
+#include <cstdint>
+
+namespace sigfs {
+
+    // Lock-free log-linear histogram, in the style of HdrHistogram.
+    //
+    // Values are sorted into power-of-two ranges, and each range is
+    // split into SUB_BUCKET_COUNT linear buckets. This gives a
+    // relative precision of 1/SUB_BUCKET_COUNT (~3%) over the entire
+    // 64 bit value range with a fixed set of counters.
+    //
+    // record() can be called concurrently by any number of threads.
+    // Snapshot accessors such as percentile() may run concurrently
+    // with record() and will then see a close approximation of the
+    // histogram.
+    //
+    class Histogram {
+    public:
+        static constexpr int SUB_BUCKET_BITS = 5;
+        static constexpr std::uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+        static constexpr int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+        Histogram(void)
+        {
+            reset();
+        }
+
+        inline void record(const std::uint64_t value)
+        {
+            buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(value, std::memory_order_relaxed);
+
+            std::uint64_t max = max_.load(std::memory_order_relaxed);
+            while(value > max &&
+                  !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+                ;
+        }
+
+        // Not atomic with regards to concurrent record() calls.
+        // A value recorded during a reset may be partially retained.
+        //
+        void reset(void)
+        {
+            for(auto& bucket: buckets_)
+                bucket.store(0, std::memory_order_relaxed);
+
+            count_.store(0, std::memory_order_relaxed);
+            sum_.store(0, std::memory_order_relaxed);
+            max_.store(0, std::memory_order_relaxed);
+        }
+
+        // Add all values recorded by another histogram.
+        void add(const Histogram& other)
+        {
+            for(int ind = 0; ind < BUCKET_COUNT; ++ind)
+                buckets_[ind].fetch_add(other.buckets_[ind].load(std::memory_order_relaxed),
+                                        std::memory_order_relaxed);
+
+            count_.fetch_add(other.count(), std::memory_order_relaxed);
+            sum_.fetch_add(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+            std::uint64_t max = max_.load(std::memory_order_relaxed);
+            while(other.max() > max &&
+                  !max_.compare_exchange_weak(max, other.max(), std::memory_order_relaxed))
+                ;
+        }
+
+        inline std::uint64_t count(void) const
+        {
+            return count_.load(std::memory_order_relaxed);
+        }
+
+        inline std::uint64_t max(void) const
+        {
+            return max_.load(std::memory_order_relaxed);
+        }
+
+        inline std::uint64_t mean(void) const
+        {
+            std::uint64_t cnt = count();
+            return cnt?(sum_.load(std::memory_order_relaxed) / cnt):0;
+        }
+
+        // Return the value at the given percentile (0.0 - 100.0).
+        //
+        // The returned value is the highest value that shares a bucket
+        // with the value at the percentile, and never greater than
+        // max().
+        //
+        std::uint64_t percentile(const double pct) const
+        {
+            std::uint64_t total = 0;
+
+            for(auto& bucket: buckets_)
+                total += bucket.load(std::memory_order_relaxed);
+
+            if (!total)
+                return 0;
+
+            std::uint64_t target = (std::uint64_t) ((pct / 100.0) * (double) total + 0.5);
+
+            if (target < 1)
+                target = 1;
+
+            std::uint64_t seen = 0;
+            for(int ind = 0; ind < BUCKET_COUNT; ++ind) {
+                seen += buckets_[ind].load(std::memory_order_relaxed);
+
+                if (seen >= target) {
+                    std::uint64_t res = bucket_highest_value(ind);
+                    return (res < max())?res:max();
+                }
+            }
+            return max();
+        }
+
+        static inline int bucket_index(const std::uint64_t value)
+        {
+            if (value < SUB_BUCKET_COUNT)
+                return (int) value;
+
+            const int msb = 63 - __builtin_clzll(value);
+            const int shift = msb - SUB_BUCKET_BITS;
+
+            return (shift + 1) * SUB_BUCKET_COUNT + (int) ((value >> shift) - SUB_BUCKET_COUNT);
+        }
+
+        static inline std::uint64_t bucket_highest_value(const int index)
+        {
+            if (index < (int) SUB_BUCKET_COUNT)
+                return index;
+
+            const int shift = index / SUB_BUCKET_COUNT - 1;
+            const std::uint64_t sub_bucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+
+            return (sub_bucket << shift) + ((std::uint64_t(1) << shift) - 1);
+        }
+
+    private:
+        std::atomic<std::uint64_t> buckets_[BUCKET_COUNT];
+        std::atomic<std::uint64_t> count_;
+        std::atomic<std::uint64_t> sum_;
+        std::atomic<std::uint64_t> max_;
+    };
+}
+#endif // __SIGFS_HISTOGRAM__
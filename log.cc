@@ -121,6 +121,11 @@ int sigfs_log_level_set(int log_level)
         return 1;
     }
 
+    if (log_level > SIGFS_LOG_MIN_LEVEL)
+        sigfs_log(SIGFS_LOG_LEVEL_WARNING, __FUNCTION__, __FILE__, __LINE__, SIGFS_NIL_INDEX,
+                  "Log level %d requested, but levels above %d are compiled out of this binary.",
+                  log_level, SIGFS_LOG_MIN_LEVEL);
+
     _sigfs_log_level = log_level;
     return 0;
 }
@@ -61,26 +61,51 @@ extern "C" {
 #define SIGFS_INDEX_COUNT 11
 #endif
 
-#ifdef SIGFS_LOG
-#define SIGFS_LOG_DEBUG(fmt, ...) { if (_sigfs_log_level >= SIGFS_LOG_LEVEL_DEBUG) sigfs_log(SIGFS_LOG_LEVEL_DEBUG, __FUNCTION__, __FILE__, __LINE__, sigfs_log_get_index(), fmt, ##__VA_ARGS__ ); }
-#define SIGFS_LOG_COMMENT(fmt, ...) { if (_sigfs_log_level >= SIGFS_LOG_LEVEL_COMMENT) sigfs_log(SIGFS_LOG_LEVEL_COMMENT, __FUNCTION__, __FILE__, __LINE__, sigfs_log_get_index(), fmt, ##__VA_ARGS__ ); }
-#define SIGFS_LOG_INFO(fmt, ...) { if (_sigfs_log_level >= SIGFS_LOG_LEVEL_INFO) sigfs_log(SIGFS_LOG_LEVEL_INFO, __FUNCTION__, __FILE__, __LINE__, sigfs_log_get_index(), fmt, ##__VA_ARGS__); }
-#define SIGFS_LOG_WARNING(fmt, ...) { if (_sigfs_log_level >= SIGFS_LOG_LEVEL_WARNING) sigfs_log(SIGFS_LOG_LEVEL_WARNING, __FUNCTION__, __FILE__, __LINE__, sigfs_log_get_index(), fmt, ##__VA_ARGS__); }
-#define SIGFS_LOG_ERROR(fmt, ...) { if (_sigfs_log_level >= SIGFS_LOG_LEVEL_ERROR) sigfs_log(SIGFS_LOG_LEVEL_ERROR, __FUNCTION__, __FILE__, __LINE__, sigfs_log_get_index(), fmt, ##__VA_ARGS__); }
-#define SIGFS_LOG_FATAL(fmt, ...) { if (_sigfs_log_level >= SIGFS_LOG_LEVEL_FATAL) sigfs_log(SIGFS_LOG_LEVEL_FATAL, __FUNCTION__, __FILE__, __LINE__, sigfs_log_get_index(), fmt, ##__VA_ARGS__); }
-#else
-#define SIGFS_LOG_DEBUG(fmt, ...) { }
-#define SIGFS_LOG_COMMENT(fmt, ...) { }
-#define SIGFS_LOG_INFO(fmt, ...) { }
-#define SIGFS_LOG_WARNING(fmt, ...) { }
-#define SIGFS_LOG_ERROR(fmt, ...) { }
-#define SIGFS_LOG_FATAL(fmt, ...) { }
+//
+// Compile-time log level threshold.
+//
+// Log statements with a level above SIGFS_LOG_MIN_LEVEL are removed
+// by the compiler, including the evaluation of their arguments.
+// Statements at or below the threshold can still be switched on and
+// off at runtime through SIGFS_LOG_LEVEL / sigfs_log_level_set().
+//
+// Build with -DSIGFS_LOG_MIN_LEVEL=SIGFS_LOG_LEVEL_WARNING to get a
+// binary where only warnings, errors, and fatal messages remain.
+//
+#ifndef SIGFS_LOG_MIN_LEVEL
+#define SIGFS_LOG_MIN_LEVEL SIGFS_LOG_LEVEL_DEBUG
+#endif
+
+#ifdef __cplusplus
+}
 #endif
 
 #ifdef __cplusplus
+namespace sigfs {
+    // Return true if log statements of the given level are
+    // compiled into the binary.
+    template<int LogLevel>
+    constexpr bool log_level_compiled(void)
+    {
+        return LogLevel <= SIGFS_LOG_MIN_LEVEL;
+    }
 }
+#define SIGFS_LOG_IF_COMPILED(level) if constexpr (sigfs::log_level_compiled<level>())
+#else
+#define SIGFS_LOG_IF_COMPILED(level) if ((level) <= SIGFS_LOG_MIN_LEVEL)
 #endif
 
+#ifdef SIGFS_LOG
+#define SIGFS_LOG_AT(level, fmt, ...) { SIGFS_LOG_IF_COMPILED(level) { if (_sigfs_log_level >= (level)) sigfs_log((level), __FUNCTION__, __FILE__, __LINE__, sigfs_log_get_index(), fmt, ##__VA_ARGS__ ); } }
+#else
+#define SIGFS_LOG_AT(level, fmt, ...) { }
+#endif
 
+#define SIGFS_LOG_DEBUG(fmt, ...) SIGFS_LOG_AT(SIGFS_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define SIGFS_LOG_COMMENT(fmt, ...) SIGFS_LOG_AT(SIGFS_LOG_LEVEL_COMMENT, fmt, ##__VA_ARGS__)
+#define SIGFS_LOG_INFO(fmt, ...) SIGFS_LOG_AT(SIGFS_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define SIGFS_LOG_WARNING(fmt, ...) SIGFS_LOG_AT(SIGFS_LOG_LEVEL_WARNING, fmt, ##__VA_ARGS__)
+#define SIGFS_LOG_ERROR(fmt, ...) SIGFS_LOG_AT(SIGFS_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define SIGFS_LOG_FATAL(fmt, ...) SIGFS_LOG_AT(SIGFS_LOG_LEVEL_FATAL, fmt, ##__VA_ARGS__)
 
 #endif // __SIGFS_LOG_H__
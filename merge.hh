@@ -0,0 +1,292 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+#ifndef __SIGFS_MERGE__
+#define __SIGFS_MERGE__
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "queue_impl.hh"
+
+namespace sigfs {
+
+    //
+    // Reads the signals of several queues as a single stream,
+    // ordered by publish time.
+    //
+    // Each source queue is read through its own Subscriber. Signals
+    // are not copied into another queue. Instead, each
+    // dequeue_signals() call does a k-way merge, with a heap of the
+    // publish time of the next signal of each source, over the
+    // signals ready to be read when the call is made.
+    //
+    // Signals published to different queues at the same time may be
+    // delivered out of order if one of them is published after the
+    // merge has passed its publish time.
+    //
+    class MergedSubscriber {
+    public:
+        // One source queue, reported to callbacks with its id.
+        struct Source {
+            std::shared_ptr<Queue> queue;
+            std::uint64_t id;
+        };
+
+        // on_ready is called whenever a signal is published to
+        // a source queue, by the publishing thread.
+        //
+        MergedSubscriber(const std::vector<Source>& sources,
+                         std::function<void(void)> on_ready = nullptr):
+            on_ready_(on_ready),
+            ready_(false),
+            waiting_(false),
+            interrupted_(false)
+        {
+            sources_.reserve(sources.size());
+
+            for(auto& source: sources)
+                sources_.emplace_back(std::make_unique<SourceSubscriber>(*this, source));
+
+            for(auto& source: sources_)
+                source->queue()->subscribe_read_ready_notifications(source.get());
+        }
+
+        ~MergedSubscriber(void)
+        {
+            // No notifications are in progress once unsubscribed.
+            for(auto& source: sources_)
+                source->queue()->unsubscribe_read_ready_notifications(source.get());
+        }
+
+        inline std::size_t source_count(void) const
+        {
+            return sources_.size();
+        }
+
+        inline std::uint64_t source_id(const std::size_t source) const
+        {
+            return sources_[source]->id();
+        }
+
+        inline std::shared_ptr<Queue> queue(const std::size_t source) const
+        {
+            return sources_[source]->queue();
+        }
+
+        //
+        // Deliver the signals ready to be read from all sources, in
+        // publish time order, by calling cb for each signal:
+        //
+        //   Queue::cb_result_t cb(std::size_t source,
+        //                         signal_id_t signal_id,
+        //                         const char* payload,
+        //                         std::uint32_t payload_size,
+        //                         signal_count_t lost_signals,
+        //                         std::uint64_t publish_time);
+        //
+        // source is the index of the source, which is resolved with
+        // source_id() and queue(). lost_signals is the number of
+        // signals lost from that source since its previous signal was
+        // delivered.
+        //
+        // cb returns processed_call_again to be called with the next
+        // signal. The other Queue::cb_result_t values stop delivery,
+        // with not_processed leaving the signal to be delivered by the
+        // next call.
+        //
+        // Blocks until at least one signal is ready. Return false,
+        // without calling cb, if interrupted by interrupt_dequeue().
+        //
+        template<typename F>
+        bool dequeue_signals(F&& cb)
+        {
+            // Publish time and source index of the next signal of
+            // each source with signals ready.
+            std::vector<std::pair<std::uint64_t, std::size_t>> heap;
+            const std::greater<std::pair<std::uint64_t, std::size_t>> later;
+
+            heap.reserve(sources_.size());
+
+            while(true) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+
+                    if (interrupted_) {
+                        interrupted_ = false;
+                        return false;
+                    }
+
+                    // Notifications from now on are caught by the
+                    // wait below.
+                    ready_ = false;
+                }
+
+                push_ready_sources_(heap);
+
+                if (!heap.empty())
+                    break;
+
+                std::unique_lock<std::mutex> lock(mutex_);
+
+                waiting_ = true;
+                cond_.wait(lock, [this] { return ready_ || interrupted_; });
+                waiting_ = false;
+            }
+
+            std::make_heap(heap.begin(), heap.end(), later);
+
+            bool stop(false);
+
+            while(!heap.empty() && !stop) {
+                std::pop_heap(heap.begin(), heap.end(), later);
+                const std::size_t source(heap.back().second);
+                heap.pop_back();
+
+                // Deliver signals from source until one is published
+                // after the next signal of another source.
+                const std::uint64_t until(heap.empty()?
+                                          std::numeric_limits<std::uint64_t>::max():
+                                          heap.front().first);
+                bool first(true);
+                bool more(false);
+                std::uint64_t next_time(0);
+                SourceSubscriber& sub(*sources_[source]);
+
+                sub.queue()->dequeue_signal(
+                    sub,
+                    [&](signal_id_t signal_id,
+                        const char* payload,
+                        std::uint32_t payload_size,
+                        signal_count_t lost_signals,
+                        signal_count_t remaining_signal_count,
+                        std::uint64_t publish_time) -> Queue::cb_result_t {
+
+                        if (!first && publish_time > until) {
+                            more = true;
+                            next_time = publish_time;
+                            return Queue::cb_result_t::not_processed;
+                        }
+
+                        first = false;
+
+                        const Queue::cb_result_t res(cb(source, signal_id, payload, payload_size,
+                                                        lost_signals, publish_time));
+
+                        if (res != Queue::cb_result_t::processed_call_again)
+                            stop = true;
+
+                        return res;
+                    });
+
+                if (more) {
+                    heap.emplace_back(next_time, source);
+                    std::push_heap(heap.begin(), heap.end(), later);
+                    continue;
+                }
+
+                // Source ran out of signals, but may have had new
+                // ones published while we were delivering the others.
+                std::uint64_t publish_time(0);
+
+                if (!stop && sub.queue()->peek_signal(sub, publish_time)) {
+                    heap.emplace_back(publish_time, source);
+                    std::push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+            return true;
+        }
+
+        // Have a blocking dequeue_signals() call, or the next call
+        // made, return false.
+        //
+        void interrupt_dequeue(void)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            interrupted_ = true;
+            cond_.notify_all();
+        }
+
+        // Return true if any source has a signal ready.
+        bool signal_available(void) const
+        {
+            for(auto& source: sources_)
+                if (source->signal_available())
+                    return true;
+
+            return false;
+        }
+
+    private:
+        class SourceSubscriber: public Subscriber {
+        public:
+            SourceSubscriber(MergedSubscriber& owner, const Source& source):
+                Subscriber(source.queue),
+                owner_(owner),
+                id_(source.id)
+            {
+            }
+
+            virtual void queue_read_ready(void)
+            {
+                owner_.queue_read_ready_();
+            }
+
+            inline std::uint64_t id(void) const
+            {
+                return id_;
+            }
+
+        private:
+            MergedSubscriber& owner_;
+            const std::uint64_t id_;
+        };
+
+        void queue_read_ready_(void)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                ready_ = true;
+
+                if (waiting_)
+                    cond_.notify_all();
+            }
+
+            if (on_ready_)
+                on_ready_();
+        }
+
+        void push_ready_sources_(std::vector<std::pair<std::uint64_t, std::size_t>>& heap) const
+        {
+            for(std::size_t source = 0; source < sources_.size(); ++source) {
+                std::uint64_t publish_time(0);
+
+                if (sources_[source]->queue()->peek_signal(*sources_[source], publish_time))
+                    heap.emplace_back(publish_time, source);
+            }
+        }
+
+        const std::function<void(void)> on_ready_;
+        std::vector<std::unique_ptr<SourceSubscriber>> sources_;
+
+        // Protected by mutex_
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        bool ready_;
+        bool waiting_;
+        bool interrupted_;
+    };
+}
+#endif // __SIGFS_MERGE__
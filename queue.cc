@@ -11,38 +11,145 @@
 // Thread safe circular queue with loss detection
 //
 
-#include "queue.hh"
+#include "queue_impl.hh"
 #include "log.h"
 #include "subscriber.hh"
+#include "crc32c.hh"
+#include "aggregate.hh"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
 using namespace sigfs;
 
-Queue::Queue(const std::uint32_t queue_size):
-    active_subscribers_(0),
-    next_sig_id_(1),
-    queue_(queue_size),
+QueueMemory::QueueMemory(const size_t size, const Options& options):
+    data_(nullptr),
+    mapped_size_(size),
+    huge_pages_(false),
+    locked_(false)
+{
+    static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+    void* data(MAP_FAILED);
+
+    // Pages are faulted in below, once the huge page and NUMA
+    // policies are set up.
+    if (options.huge_pages) {
+        const size_t huge_size((size + huge_page_size - 1) & ~(huge_page_size - 1));
+
+        data = mmap(nullptr, huge_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (data != MAP_FAILED) {
+            mapped_size_ = huge_size;
+            huge_pages_ = true;
+        }
+        else
+            SIGFS_LOG_INFO("QueueMemory(): No %lu bytes of huge pages available: %s. Using transparent huge pages.",
+                           huge_size, strerror(errno));
+    }
+
+    if (data == MAP_FAILED) {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (data == MAP_FAILED) {
+            SIGFS_LOG_FATAL("QueueMemory(): Could not map %lu bytes: %s", size, strerror(errno));
+            exit(255);
+        }
+
+        if (options.huge_pages && madvise(data, size, MADV_HUGEPAGE))
+            SIGFS_LOG_INFO("QueueMemory(): Transparent huge pages not available: %s", strerror(errno));
+    }
+
+    data_ = (char*) data;
+
+    if (options.numa_node >= 0) {
+        // MPOL_PREFERRED falls back to other nodes when the given
+        // one is out of memory.
+        static constexpr int bits = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> node_mask(options.numa_node / bits + 1, 0);
+
+        node_mask[options.numa_node / bits] |= 1UL << (options.numa_node % bits);
+
+        if (syscall(SYS_mbind, data_, mapped_size_, MPOL_PREFERRED,
+                    node_mask.data(), node_mask.size() * bits + 1, 0))
+            SIGFS_LOG_WARNING("QueueMemory(): Could not place %lu bytes on NUMA node %d: %s",
+                              mapped_size_, options.numa_node, strerror(errno));
+    }
+
+    // Prefault.
+    if (options.huge_pages || options.lock) {
+        const size_t page_size(huge_pages_?huge_page_size:sysconf(_SC_PAGESIZE));
+
+        for(size_t offset = 0; offset < mapped_size_; offset += page_size)
+            ((volatile char*) data_)[offset] = 0;
+    }
+
+    if (options.lock) {
+        if (!mlock(data_, mapped_size_))
+            locked_ = true;
+        else
+            SIGFS_LOG_WARNING("QueueMemory(): Could not lock %lu bytes in RAM: %s. Check RLIMIT_MEMLOCK.",
+                              mapped_size_, strerror(errno));
+    }
+
+    SIGFS_LOG_DEBUG("QueueMemory(): %lu bytes. huge_pages[%c] locked[%c] numa_node[%d]",
+                    mapped_size_, huge_pages_?'y':'n', locked_?'y':'n', options.numa_node);
+}
+
+QueueMemory::~QueueMemory(void)
+{
+    munmap(data_, mapped_size_);
+}
+
+
+template<typename SyncPolicy, typename StoragePolicy>
+QueueEngine<SyncPolicy, StoragePolicy>::QueueEngine(const std::uint32_t queue_size,
+                                             const std::uint64_t id,
+                                             const std::uint32_t slot_size,
+                                             const QueueMemory::Options& memory,
+                                             const bool on_change,
+                                             const overflow_t overflow,
+                                             const std::uint64_t overflow_timeout):
+    id_(id),
+    on_change_(on_change),
+    overflow_(overflow),
+    overflow_timeout_(overflow_timeout),
+    queue_(queue_size, slot_size, memory),
     queue_mask_(queue_size-1),
+    next_sig_id_(1),
     head_(1),
-    tail_(1)
+    tail_(1),
+    last_crc_(0),
+    min_sub_sig_id_(1),
+    write_full_(false),
+    writers_waiting_(0),
+    active_subscribers_(0)
 {
     if (queue_size < 4) {
-        SIGFS_LOG_FATAL("Queue::Queue(): queue_size < 4");
+        SIGFS_LOG_FATAL("QueueEngine::QueueEngine(): queue_size < 4");
         exit(255);
     }
 
     if (queue_size & (queue_size - 1)) {
-        SIGFS_LOG_FATAL("Queue::Queue(): queue_size[%u] is not a power of 2", queue_size);
+        SIGFS_LOG_FATAL("QueueEngine::QueueEngine(): queue_size[%u] is not a power of 2", queue_size);
         exit(255);
     }
-    SIGFS_LOG_DEBUG("Queue::Queue(): queue_size_[%u]", queue_size);
+    SIGFS_LOG_DEBUG("QueueEngine::QueueEngine(): queue_size_[%u] sync[%s] storage[%s]",
+                    queue_size, SyncPolicy::name, StoragePolicy::name);
 }
 
 
-Queue::~Queue(void)
+template<typename SyncPolicy, typename StoragePolicy>
+QueueEngine<SyncPolicy, StoragePolicy>::~QueueEngine(void)
 {
 }
 
 
-void Queue::dump(const char* prefix, const Subscriber& sub)
+template<typename SyncPolicy, typename StoragePolicy>
+void QueueEngine<SyncPolicy, StoragePolicy>::dump(const char* prefix, const Subscriber& sub)
 {
 
 #ifdef SIGFS_LOG
@@ -78,10 +185,60 @@ void Queue::dump(const char* prefix, const Subscriber& sub)
 #endif
 }
 
-void Queue::queue_signal(const char* data, const size_t data_size)
+template<typename SyncPolicy, typename StoragePolicy>
+bool QueueEngine<SyncPolicy, StoragePolicy>::has_space_(void) const
+{
+    // The queue holds queue_mask_ signals, since the slot at head_
+    // is always being filled.
+    if (next_sig_id_ - min_sub_sig_id_ < queue_mask_)
+        return true;
+
+    // Subscribers have moved on since min_sub_sig_id_ was set.
+    // Find the slowest one.
+    signal_id_t min_sig_id(next_sig_id_);
+
+    for(auto sub: subscribers_)
+        if (sub->sig_id() < min_sig_id)
+            min_sig_id = sub->sig_id();
+
+    min_sub_sig_id_ = min_sig_id;
+    if (next_sig_id_ - min_sub_sig_id_ < queue_mask_)
+        return true;
+
+    write_full_ = true;
+    return false;
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+bool QueueEngine<SyncPolicy, StoragePolicy>::wait_for_space_(std::unique_lock<mutex_t>& lock, const bool nonblock)
+{
+    if (has_space_())
+        return true;
+
+    if (overflow_ == overflow_t::reject || nonblock)
+        return false;
+
+    ++writers_waiting_;
+    const bool res(write_ready_cond_.wait_for(lock,
+                                              std::chrono::nanoseconds(overflow_timeout_),
+                                              [this] { return has_space_(); }));
+    --writers_waiting_;
+    return res;
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+bool QueueEngine<SyncPolicy, StoragePolicy>::queue_signal(const char* data, const size_t data_size, const bool nonblock)
 {
 
     SIGFS_LOG_DEBUG("queue_signal(): Called");
+    SIGFS_TRACE2(queue_signal_entry, id_, data_size);
+    [[maybe_unused]] signal_id_t sig_id; // Reported by the queue_signal_return probe
+
+    // Checksum the payload before taking the lock, leaving a
+    // compare of two integers for the common case of a changed
+    // payload.
+    const std::uint32_t crc(on_change_?crc32c(data, data_size):0);
+
     //
     // Do we have active subscribers?
     //
@@ -92,7 +249,7 @@ void Queue::queue_signal(const char* data, const size_t data_size)
     //
     /*
     {
-        const Queue& self(*this);
+        const QueueEngine& self(*this);
         std::unique_lock prio_lock(prio_mutex_);
         SIGFS_LOG_DEBUG("queue_signal(): Prio lock acquired. ");
 
@@ -117,9 +274,38 @@ void Queue::queue_signal(const char* data, const size_t data_size)
     {
         std::unique_lock lock(read_ready_mutex_);
 
+        // Do not overwrite signals that subscribers have yet to
+        // read. Checked ahead of on_change_, so that a rejected
+        // payload is not taken as the last one published.
+        //
+        if (overflow_ != overflow_t::overwrite && !wait_for_space_(lock, nonblock)) {
+            SIGFS_LOG_DEBUG("queue_signal(): Queue full. Rejected.");
+            signals_rejected_.increment();
+            SIGFS_TRACE3(queue_signal_return, id_, 0, data_size);
+            return false;
+        }
+
+        if (on_change_) {
+            // Compare the payloads on a checksum match to rule out
+            // collisions.
+            if (!empty() && crc == last_crc_) {
+                const payload_t* last(queue_[prev(head_)].payload());
+
+                if (last->payload_size == data_size && !memcmp(last->payload, data, data_size)) {
+                    SIGFS_LOG_DEBUG("queue_signal(): Payload unchanged. Dropped.");
+                    signals_suppressed_.increment();
+                    SIGFS_TRACE3(queue_signal_return, id_, 0, data_size);
+                    return true;
+                }
+            }
+            last_crc_ = crc;
+        }
+
         SIGFS_LOG_DEBUG("queue_signal(): Assigned signal ID [%lu]", next_sig_id_);
-        queue_[head_].set(next_sig_id_, data, data_size);
-        next_sig_id_++;
+        queue_[head_].set(next_sig_id_, timestamp(), data, data_size);
+        sig_id = next_sig_id_++;
+        signals_published_.increment();
+        bytes_published_.add(data_size);
         // Clear write lock so that pending readers can process.
 
         // Unlock queue element so that readers will get their read lock and can
@@ -134,32 +320,183 @@ void Queue::queue_signal(const char* data, const size_t data_size)
         // Nil Sig ID for clarity. No functionality is associated with this.
         queue_[head_].set_sig_id(0);
 
-        // Notify all read waiting for this data.
-        SIGFS_LOG_DEBUG("queue_signal(): Will notify %d readers waiting on signal", read_notifiers_.size());
-        {
-            std::lock_guard<std::mutex> lock(read_notifiers_mutex_);
-            for(auto iter: read_notifiers_) {
-                iter->queue_read_ready();
-            }
-        }
     }
     // Notify other dequeue_signal() callers waiting on conditional lock above
     read_ready_cond_.notify_all();
 
-    return;
+    // Notify all read waiting for this data. Done with
+    // read_ready_mutex_ unlocked, so that readers and other
+    // publishers are not held up by the notifiers. A notifier that
+    // checks for signals before this call sees the signal queued
+    // above.
+    //
+    {
+        std::lock_guard<std::mutex> lock(read_notifiers_mutex_);
+        SIGFS_LOG_DEBUG("queue_signal(): Will notify %d readers waiting on signal", read_notifiers_.size());
+        for(auto iter: read_notifiers_) {
+            iter->queue_read_ready();
+        }
+    }
+    SIGFS_TRACE3(queue_signal_return, id_, sig_id, data_size);
+
+    return true;
 }
 
 
 
-const signal_count_t Queue::signal_available(const Subscriber& sub) const
+template<typename SyncPolicy, typename StoragePolicy>
+const signal_count_t QueueEngine<SyncPolicy, StoragePolicy>::signal_available(const Subscriber& sub) const
 {
     SIGFS_LOG_DEBUG("signal_available(): Called");
     std::unique_lock lock(read_ready_mutex_);
 
-    return signal_available_(sub);
+    if (!signal_available_(sub))
+        return false;
+
+    if (sub.filter().empty() && sub.rate().empty())
+        return true;
+
+    // Only report signals that will pass the filter and rate limit,
+    // so that poll() does not wake up a reader that would then
+    // block. Signals lost by sub are skipped by the next read.
+    //
+    const signal_id_t tail_id(tail_sig_id_());
+    signal_count_t filtered(0);
+    signal_count_t skipped(0);
+
+    return next_deliverable_(sub,
+                             (sub.sig_id() < tail_id)?tail_id:sub.sig_id(),
+                             sub.rate_state(),
+                             filtered,
+                             skipped) != next_sig_id_ &&
+        !held_(sub, sub.rate_state());
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+std::uint64_t QueueEngine<SyncPolicy, StoragePolicy>::signal_held_until(const Subscriber& sub) const
+{
+    std::unique_lock lock(read_ready_mutex_);
+
+    if (!signal_available_(sub) || !held_(sub, sub.rate_state()))
+        return 0;
+
+    const signal_id_t tail_id(tail_sig_id_());
+    signal_count_t filtered(0);
+    signal_count_t skipped(0);
+
+    if (next_deliverable_(sub,
+                          (sub.sig_id() < tail_id)?tail_id:sub.sig_id(),
+                          sub.rate_state(),
+                          filtered,
+                          skipped) == next_sig_id_)
+        return 0;
+
+    return sub.rate_state().next_time;
 }
 
-const bool Queue::signal_available_(const Subscriber& sub) const
+template<typename SyncPolicy, typename StoragePolicy>
+void QueueEngine<SyncPolicy, StoragePolicy>::set_lag(Subscriber& sub, const LagPolicy& lag)
+{
+    std::lock_guard<mutex_t> lock(read_ready_mutex_);
+    sub.set_lag(lag);
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+signal_id_t QueueEngine<SyncPolicy, StoragePolicy>::seek(Subscriber& sub,
+                                                         const seek_t whence,
+                                                         const std::uint64_t value,
+                                                         signal_count_t& lost_signals)
+{
+    std::unique_lock<mutex_t> lock(read_ready_mutex_);
+    const signal_id_t oldest(empty()?next_sig_id_:tail_sig_id_());
+    signal_id_t id(next_sig_id_);
+
+    switch(whence) {
+    case seek_t::signal_id:
+        // Signal ids start at 1. There is no signal 0 to have lost.
+        if (!value)
+            id = oldest;
+        else
+            id = (value < next_sig_id_)?value:next_sig_id_;
+        break;
+
+    case seek_t::oldest:
+        id = oldest;
+        break;
+
+    case seek_t::newest:
+        // Signal ids start at 1.
+        id = (value < next_sig_id_)?next_sig_id_ - value:1;
+        break;
+    }
+
+    lost_signals = 0;
+    if (id < oldest) {
+        lost_signals = oldest - id;
+        id = oldest;
+    }
+
+    // Keep publishers from overwriting the signals sub moved back to.
+    if (id < min_sub_sig_id_)
+        min_sub_sig_id_ = id;
+
+    SIGFS_LOG_DEBUG("seek(): Subscriber [%d] moved from [%lu] to [%lu]. Lost [%u]",
+                    sub.sub_id(), sub.sig_id(), id, lost_signals);
+    sub.set_sig_id(id);
+    sub.set_rate_state(DeliveryRate::state_t());
+
+    // Have blocked readers of sub check their new position.
+    read_ready_cond_.notify_all();
+
+    if (write_ready_()) {
+        lock.unlock();
+        notify_write_ready_();
+    }
+    return id;
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+bool QueueEngine<SyncPolicy, StoragePolicy>::peek_signal(const Subscriber& sub, std::uint64_t& publish_time) const
+{
+    std::lock_guard<mutex_t> lock(read_ready_mutex_);
+
+    if (!signal_available_(sub))
+        return false;
+
+    // A subscriber that has lost signals reads the oldest signal
+    // in the queue next.
+    const signal_id_t tail_id(tail_sig_id_());
+
+    publish_time = queue_[index((sub.sig_id() < tail_id)?tail_id:sub.sig_id())].publish_time();
+    return true;
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+bool QueueEngine<SyncPolicy, StoragePolicy>::write_space_available(void)
+{
+    if (overflow_ == overflow_t::overwrite)
+        return true;
+
+    std::lock_guard<mutex_t> lock(read_ready_mutex_);
+    return has_space_();
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+void QueueEngine<SyncPolicy, StoragePolicy>::set_filter(Subscriber& sub, const SignalFilter& filter)
+{
+    std::lock_guard<mutex_t> lock(read_ready_mutex_);
+    sub.set_filter(filter);
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+void QueueEngine<SyncPolicy, StoragePolicy>::set_rate(Subscriber& sub, const DeliveryRate& rate)
+{
+    std::lock_guard<mutex_t> lock(read_ready_mutex_);
+    sub.set_rate(rate);
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+const bool QueueEngine<SyncPolicy, StoragePolicy>::signal_available_(const Subscriber& sub) const
 {
     if (head() == tail() || index(sub.sig_id()) == head()) {
         SIGFS_LOG_DEBUG("signal_available(): head{%u} %s tail{%u} --- index(sub.sig_id{%lu}){%u} %s head{%u} -> Signal not available.",
@@ -186,10 +523,11 @@ const bool Queue::signal_available_(const Subscriber& sub) const
     return true;
 }
 
-void Queue::interrupt_dequeue(Subscriber& sub)
+template<typename SyncPolicy, typename StoragePolicy>
+void QueueEngine<SyncPolicy, StoragePolicy>::interrupt_dequeue(Subscriber& sub)
 {
     SIGFS_LOG_DEBUG("interrupt_dequeue(): Called");
-    std::unique_lock<std::mutex> lock(read_ready_mutex_);
+    std::unique_lock<mutex_t> lock(read_ready_mutex_);
     SIGFS_LOG_DEBUG("interrupt_dequeue(): Lock acquired");
 
     // Wait for condition to be fulfilled.
@@ -203,8 +541,187 @@ void Queue::interrupt_dequeue(Subscriber& sub)
     read_ready_cond_.notify_all();
 }
 
-void Queue::initialize_subscriber(Subscriber& sub) const
+template<typename SyncPolicy, typename StoragePolicy>
+void QueueEngine<SyncPolicy, StoragePolicy>::initialize_subscriber(Subscriber& sub)
 {
-    std::lock_guard<std::mutex> lock(read_ready_mutex_);
+    std::lock_guard<mutex_t> lock(read_ready_mutex_);
     sub.set_sig_id(next_sig_id_);
+
+    if (sub.is_reader())
+        subscribers_.insert(&sub);
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+void QueueEngine<SyncPolicy, StoragePolicy>::release_subscriber(Subscriber& sub)
+{
+    std::unique_lock<mutex_t> lock(read_ready_mutex_);
+    subscribers_.erase(&sub);
+
+    // Publishers may have been waiting for sub.
+    if (write_ready_()) {
+        lock.unlock();
+        notify_write_ready_();
+    }
+}
+
+template<typename SyncPolicy, typename StoragePolicy>
+QueueBase::Stats QueueEngine<SyncPolicy, StoragePolicy>::statistics(void) const
+{
+    Stats res;
+
+    res.queue_length = queue_length();
+    res.signals_published = signals_published_.get();
+    res.bytes_published = bytes_published_.get();
+    res.signals_lost = signals_lost_.get();
+    res.signals_suppressed = signals_suppressed_.get();
+    res.signals_rejected = signals_rejected_.get();
+    res.peak_occupancy = peak_occupancy_.get();
+    res.latency.count = delivery_latency_.count();
+    res.latency.mean = delivery_latency_.mean();
+    res.latency.p50 = delivery_latency_.percentile(50.0);
+    res.latency.p99 = delivery_latency_.percentile(99.0);
+    res.latency.p999 = delivery_latency_.percentile(99.9);
+    res.latency.max = delivery_latency_.max();
+
+    std::lock_guard<mutex_t> lock(read_ready_mutex_);
+    res.subscribers.reserve(subscribers_.size());
+
+    for(auto sub: subscribers_) {
+        res.subscribers.push_back(SubscriberStats {
+                .sub_id = sub->sub_id(),
+                .signals_delivered = sub->signals_delivered(),
+                .signals_lost = sub->signals_lost(),
+                .signals_filtered = sub->signals_filtered(),
+                .signals_skipped = sub->signals_skipped(),
+                .lag = next_sig_id_ - sub->sig_id()
+            });
+    }
+    return res;
+}
+
+template class sigfs::QueueEngine<MutexSync, HeapStorage>;
+template class sigfs::QueueEngine<MutexSync, ArenaStorage>;
+template class sigfs::QueueEngine<SpinSync, HeapStorage>;
+template class sigfs::QueueEngine<SpinSync, ArenaStorage>;
+template class sigfs::QueueEngine<MutexSync, InlineStorage>;
+template class sigfs::QueueEngine<SpinSync, InlineStorage>;
+
+
+Queue::Queue(const index_t queue_length, const std::uint64_t id, const Config& config):
+    config_(config),
+    has_aggregators_(false)
+{
+    using sync_t = Config::sync_t;
+    using storage_t = Config::storage_t;
+
+    if (config.storage == storage_t::heap && !config.memory.is_default())
+        SIGFS_LOG_WARNING("Queue::Queue(): huge_pages, mlock and numa_node have no effect on heap queue storage.");
+
+    if (config.sync == sync_t::mutex && config.storage == storage_t::heap)
+        engine_ = std::make_unique<QueueEngine<MutexSync, HeapStorage>>(queue_length, id, config.slot_size, config.memory, config.on_change, config.overflow, config.overflow_timeout);
+    else if (config.sync == sync_t::mutex && config.storage == storage_t::arena)
+        engine_ = std::make_unique<QueueEngine<MutexSync, ArenaStorage>>(queue_length, id, config.slot_size, config.memory, config.on_change, config.overflow, config.overflow_timeout);
+    else if (config.sync == sync_t::mutex && config.storage == storage_t::inline_slot)
+        engine_ = std::make_unique<QueueEngine<MutexSync, InlineStorage>>(queue_length, id, config.slot_size, config.memory, config.on_change, config.overflow, config.overflow_timeout);
+    else if (config.sync == sync_t::spin && config.storage == storage_t::heap)
+        engine_ = std::make_unique<QueueEngine<SpinSync, HeapStorage>>(queue_length, id, config.slot_size, config.memory, config.on_change, config.overflow, config.overflow_timeout);
+    else if (config.sync == sync_t::spin && config.storage == storage_t::arena)
+        engine_ = std::make_unique<QueueEngine<SpinSync, ArenaStorage>>(queue_length, id, config.slot_size, config.memory, config.on_change, config.overflow, config.overflow_timeout);
+    else
+        engine_ = std::make_unique<QueueEngine<SpinSync, InlineStorage>>(queue_length, id, config.slot_size, config.memory, config.on_change, config.overflow, config.overflow_timeout);
+}
+
+Queue::~Queue(void)
+{
+}
+
+void Queue::add_aggregator(std::shared_ptr<Aggregator> aggregator)
+{
+    std::lock_guard<std::mutex> lock(aggregators_mutex_);
+
+    aggregators_.push_back(aggregator);
+    has_aggregators_ = true;
+}
+
+void Queue::aggregate_(const char* data, const size_t data_sz)
+{
+    const std::uint64_t now(timestamp());
+    std::lock_guard<std::mutex> lock(aggregators_mutex_);
+
+    for(auto& aggregator: aggregators_)
+        aggregator->add(data, data_sz, now);
+}
+
+
+bool QueueConfig::parse_sync(const std::string& name, sync_t& res)
+{
+    if (name == MutexSync::name)
+        res = sync_t::mutex;
+    else if (name == SpinSync::name)
+        res = sync_t::spin;
+    else
+        return false;
+
+    return true;
+}
+
+bool QueueConfig::parse_overflow(const std::string& name, QueueBase::overflow_t& res)
+{
+    if (name == "overwrite")
+        res = QueueBase::overflow_t::overwrite;
+    else if (name == "block")
+        res = QueueBase::overflow_t::block;
+    else if (name == "eagain")
+        res = QueueBase::overflow_t::reject;
+    else
+        return false;
+
+    return true;
+}
+
+bool QueueConfig::parse_storage(const std::string& name, storage_t& res)
+{
+    if (name == HeapStorage::name)
+        res = storage_t::heap;
+    else if (name == ArenaStorage::name)
+        res = storage_t::arena;
+    else if (name == InlineStorage::name)
+        res = storage_t::inline_slot;
+    else
+        return false;
+
+    return true;
+}
+
+const char* QueueConfig::sync_name(void) const
+{
+    return (sync == sync_t::mutex)?MutexSync::name:SpinSync::name;
+}
+
+const char* QueueConfig::storage_name(void) const
+{
+    switch(storage) {
+    case storage_t::heap:
+        return HeapStorage::name;
+
+    case storage_t::arena:
+        return ArenaStorage::name;
+
+    default:
+        return InlineStorage::name;
+    }
+}
+
+const char* QueueConfig::overflow_name(void) const
+{
+    switch(overflow) {
+    case QueueBase::overflow_t::block:
+        return "block";
+
+    case QueueBase::overflow_t::reject:
+        return "eagain";
+
+    default:
+        return "overwrite";
+    }
 }
@@ -9,17 +9,34 @@
 #ifndef __SIGFS_QUEUE__
 #define __SIGFS_QUEUE__
 #include "sigfs_common.h"
+#include "stats.hh"
+#include "histogram.hh"
+#include "sigfs_trace.h"
+#include "queue_policy.hh"
+#include "filter.hh"
 #include <functional>
 #include <mutex>
 #include <set>
+#include <vector>
+#include <variant>
+#include <memory>
+#include <atomic>
+#include <string>
 #include <condition_variable>
+#include <chrono>
 #include <memory.h>
+#include <time.h>
 namespace sigfs {
 
     class Subscriber;
+    class Aggregator;
 
+    template<typename SyncPolicy, typename StoragePolicy>
+    class QueueEngine;
 
-    class Queue {
+    // Types shared by Queue and the queue engines behind it.
+    //
+    class QueueBase {
     public:
         using index_t = std::uint32_t;
 
@@ -27,10 +44,7 @@ namespace sigfs {
         // The struct returned by each read operation.
         // Reads should continue until you have received sizeof(sigfs_signal_t) + data_size bytes.
         //
-        typedef struct payload_t_ {
-            uint32_t payload_size = 0; // Number of bytes in data.
-            char payload[];
-        } payload_t;
+        using payload_t = queue_payload_t;
 
         using cb_result_t = enum {
             // Callback can be invoked again by the dequeue_signal()
@@ -62,6 +76,8 @@ namespace sigfs {
         // payload_size - The number of bytes in payload
         // lost_signals - The number of signals that were lost between the last call to dequeue_signal() and this call.
         // remaining_signal_count - The number of remaining signals ready to be processed once the callback returns.
+        //                          Includes signals that will be skipped by the subscriber filter.
+        // publish_time - Queue::timestamp() at the time the signal was queued.
         //
         // If the callback returns true, it means that the dequeue_signal() that invoked the callback is
         // free to do so again in order to deliver additional signals that are ready to be processed.
@@ -75,73 +91,204 @@ namespace sigfs {
                                                             const char* payload,
                                                             std::uint32_t payload_size,
                                                             signal_count_t lost_signals,
-                                                            signal_count_t remaining_signal_count)>;
+                                                            signal_count_t remaining_signal_count,
+                                                            std::uint64_t publish_time)>;
 
 
-        // length has to be a power of 2:
-        // 2 4 8 16 32, 64, 128, etc
-        Queue(const index_t queue_length);
-        ~Queue(void);
-
-
-        // Queue data as a signal on queue.
-        void queue_signal(const char* data, const size_t data_sz);
-
-        //
-        // Retrieve the data of the next signal for us to read.
+        // A single signal in a SignalBatch.
         //
-        // For each signal processed, the cb callback will be invoked.
-        // If cb returns true, and there are additional signals to be processed,
-        // cb will be called again until either there are no more signals or
-        // cb returns false.
+        struct SignalRef {
+            signal_id_t signal_id;
+            const char* payload;
+            std::uint32_t payload_size;
+            std::uint64_t publish_time;
+            signal_count_t signals_skipped; // Skipped by the subscriber rate limit before this signal.
+        };
+
+        // Up to max_size consecutive signals ready to be read by a
+        // subscriber, handed to the callback of dequeue_signals().
         //
-        // Having cb called multiple times speeds up processing since all callbacks
-        // are done with the relevant resoruces mutex-locked only once at the beginning
-        // of the dequeue_signal() call.
+        // The payloads are owned by the queue and are only valid
+        // until the callback returns, since the queue is locked
+        // while the callback runs.
         //
-        // If not signal is available, this method will block until
-        // another thread calls queue_signal().
+        class SignalBatch {
+        public:
+            static constexpr std::size_t max_size = 64;
+
+            inline std::size_t size(void) const { return size_; }
+            inline bool empty(void) const { return !size_; }
+
+            inline const SignalRef& operator[](const std::size_t ind) const { return signals_[ind]; }
+            inline const SignalRef* begin(void) const { return signals_; }
+            inline const SignalRef* end(void) const { return signals_ + size_; }
+
+            // Signals lost before the first signal of the batch.
+            inline signal_count_t lost_signals(void) const { return lost_signals_; }
+
+            // Signals ready to be read after the last signal of the
+            // batch, including signals not passing the subscriber filter.
+            inline signal_count_t remaining_signal_count(void) const { return remaining_; }
+
+        private:
+            template<typename SyncPolicy, typename StoragePolicy>
+            friend class QueueEngine;
+
+            SignalRef signals_[max_size];
+            std::size_t size_ = 0;
+            signal_count_t lost_signals_ = 0;
+            signal_count_t remaining_ = 0;
+        };
+
+        // What Queue::queue_signal() does when the oldest signal in
+        // the queue has not yet been read by all subscribers.
         //
-        // See below for instructions on how to interrupt this call.
+        enum class overflow_t {
+            overwrite, // Overwrite it. The subscribers lose the signal.
+            block,     // Wait for the subscribers to read it.
+            reject     // Reject the new signal.
+        };
+
+        // Positions that Queue::seek() can move a subscriber to.
         //
-        template<typename CallbackT=void*>
-        bool dequeue_signal(Subscriber& sub,
-                            CallbackT userdata,
-                            signal_callback_t<CallbackT>& cb) const;
+        enum class seek_t {
+            signal_id, // The signal with a given id
+            oldest,    // The oldest signal in the queue
+            newest     // A given number of signals back from the newest one
+        };
 
+        // Statistics for a single reading subscriber, as reported
+        // by Queue::statistics()
         //
-        // Interrupt an ongoing dequeue_signal() call that is
-        // blocking.
+        struct SubscriberStats {
+            int sub_id;
+            std::uint64_t signals_delivered; // Signals handed to the subscriber
+            std::uint64_t signals_lost;      // Signals overwritten before they were read
+            std::uint64_t signals_filtered;  // Signals skipped by the subscriber filter
+            std::uint64_t signals_skipped;   // Signals skipped by the subscriber rate limit and lag policy
+            std::uint64_t lag;               // Signals published but not yet read
+        };
+
+        // Snapshot of the queue statistics.
         //
-        // This will cause all threads currently blocking on
-        // dequeue_signal() to invoke cb with the payload argumentset
-        // to NULL and payload_size set to 0. After cb returns,
-        // dequeue_signal() will return.
+        struct Stats {
+            index_t queue_length;
+            std::uint64_t signals_published;
+            std::uint64_t bytes_published;
+            std::uint64_t signals_lost;      // Total for all subscribers, including closed ones.
+            std::uint64_t signals_suppressed; // Repeated payloads dropped by QueueConfig::on_change
+            std::uint64_t signals_rejected;  // Signals not queued since the queue was full
+            std::uint64_t peak_occupancy;    // Max number of unread signals seen by any subscriber.
+
+            // Publish-to-delivery latency, in nanoseconds.
+            struct {
+                std::uint64_t count;
+                std::uint64_t mean;
+                std::uint64_t p50;
+                std::uint64_t p99;
+                std::uint64_t p999;
+                std::uint64_t max;
+            } latency;
+
+            std::vector<SubscriberStats> subscribers;
+        };
+
+        // Monotonic nanosecond clock used to timestamp signals.
         //
-        // cb will only be called once to deliver the interrupt
-        // notification, even if the single_callback argument to
-        // dequeue_signal() is set to false.
+        // CLOCK_MONOTONIC is served by the vDSO and does not
+        // enter the kernel.
         //
+        static inline std::uint64_t timestamp(void)
+        {
+            struct timespec ts;
+
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (std::uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+
+    };
+
+
+    //
+    // Thread safe circular queue with loss detection.
+    //
+    // SyncPolicy and StoragePolicy are described in queue_policy.hh.
+    // Use Queue, which selects the engine at runtime, rather than
+    // this class directly. See Queue for a description of each
+    // method.
+    //
+    template<typename SyncPolicy, typename StoragePolicy>
+    class QueueEngine: public QueueBase {
+    public:
+        using mutex_t = typename SyncPolicy::mutex_t;
+        using cond_t = typename SyncPolicy::cond_t;
+
+        QueueEngine(const index_t queue_length,
+                    const std::uint64_t id,
+                    const std::uint32_t slot_size,
+                    const QueueMemory::Options& memory,
+                    const bool on_change,
+                    const overflow_t overflow,
+                    const std::uint64_t overflow_timeout);
+        ~QueueEngine(void);
+
+        bool queue_signal(const char* data, const size_t data_sz, const bool nonblock);
+
+        template<typename F>
+        bool dequeue_signal(Subscriber& sub, F&& cb) const;
+
+        template<typename F>
+        bool dequeue_signals(Subscriber& sub, std::size_t max_count, F&& cb) const;
+
         void interrupt_dequeue(Subscriber& sub);
 
-        // Return the number of signals available through
-        // dequeue_signal() calls.
-        //
+        void set_filter(Subscriber& sub, const SignalFilter& filter);
+
+        void set_rate(Subscriber& sub, const DeliveryRate& rate);
+
+        void set_lag(Subscriber& sub, const LagPolicy& lag);
+
+        signal_id_t seek(Subscriber& sub,
+                         const seek_t whence,
+                         const std::uint64_t value,
+                         signal_count_t& lost_signals);
+
         const signal_count_t signal_available(const Subscriber& sub) const;
 
+        std::uint64_t signal_held_until(const Subscriber& sub) const;
+
+        bool peek_signal(const Subscriber& sub, std::uint64_t& publish_time) const;
+
+        bool write_space_available(void);
 
         inline index_t queue_length(void) const {
             return queue_mask_+1;
         }
 
+        inline std::uint64_t id(void) const {
+            return id_;
+        }
+
         void dump(const char* prefix, const Subscriber& sub);
 
         inline const signal_id_t tail_sig_id(void) const {
-            std::lock_guard<std::mutex> lock(read_ready_mutex_);
+            std::lock_guard<mutex_t> lock(read_ready_mutex_);
             return tail_sig_id_();
         }
 
-        void initialize_subscriber(Subscriber& sub) const;
+        void initialize_subscriber(Subscriber& sub);
+
+        void release_subscriber(Subscriber& sub);
+
+        Stats statistics(void) const;
+
+        inline Histogram& delivery_latency(void) {
+            return delivery_latency_;
+        }
+
+        inline const Histogram& delivery_latency(void) const {
+            return delivery_latency_;
+        }
 
         void subscribe_read_ready_notifications(Subscriber* subscriber) {
             std::lock_guard<std::mutex> lock(read_notifiers_mutex_);
@@ -154,6 +301,16 @@ namespace sigfs {
             read_notifiers_.erase(subscriber);
         }
 
+        void subscribe_write_ready_notifications(Subscriber* subscriber) {
+            std::lock_guard<std::mutex> lock(write_notifiers_mutex_);
+            write_notifiers_.insert(subscriber);
+        }
+
+        void unsubscribe_write_ready_notifications(Subscriber* subscriber) {
+            std::lock_guard<std::mutex> lock(write_notifiers_mutex_);
+            write_notifiers_.erase(subscriber);
+        }
+
     private:
 
 
@@ -212,70 +369,114 @@ namespace sigfs {
         // Not thread safe.
         const bool signal_available_(const Subscriber& sub) const;
 
-    private:
+        // Not thread safe.
+        // Return the id of the first signal, starting with id, to be
+        // delivered to sub given its filter and its rate limit in
+        // state. Return next_sig_id_ if there is no such signal.
+        //
+        // With a minimum interval, the signal returned is not to be
+        // delivered until held_() returns false.
+        //
+        // The number of signals passed over are added to filtered
+        // and skipped.
+        //
+        inline signal_id_t next_deliverable_(const Subscriber& sub,
+                                             signal_id_t id,
+                                             const DeliveryRate::state_t& state,
+                                             signal_count_t& filtered,
+                                             signal_count_t& skipped) const;
+
+        // Return true if the minimum interval of sub, given its rate
+        // limit state, is not yet up.
+        //
+        static inline bool held_(const Subscriber& sub, const DeliveryRate::state_t& state);
 
-        class Signal {
-        public:
-            Signal(void):
-                payload_alloc_(0),
-                sig_id_(0),
-                payload_{}
-            {
-            }
-
-            ~Signal(void)
-            {
-                if (payload_)
-                    delete[] (char*) payload_;
-            }
-
-
-            inline const payload_t* payload(void) const
-            {
-                return payload_;
-            }
-
-
-            // Not thread safe! Caller must manage locks
-            inline const id_t sig_id(void) const
-            {
-                return sig_id_;
-            }
-
-            // Not thread safe! Caller must manage locks
-            inline void set_sig_id(const id_t id)
-            {
-                sig_id_ = id;
-            }
-
-            inline void set(const id_t sig_id, const char* payload, const size_t payload_size)
-            {
-                // First time allocation?
-                if (payload_size + sizeof(sigfs_signal_t) > payload_alloc_) {
-                    if (payload_)
-                        delete[] (char*) payload_;
-
-                    payload_ = (payload_t*) new  char[sizeof(payload_t) + payload_size];
-                    payload_alloc_ = payload_size + sizeof(payload_t);
-                }
-
-                payload_->payload_size = payload_size;
-                memcpy(payload_->payload, payload, payload_size);
-                sig_id_ = sig_id;
-            }
+        // Not thread safe.
+        // Move sub past signals not passing its filter and rate
+        // limit. Return false if there are no signals left for sub
+        // to read, or if the next one is held back by held_().
+        //
+        inline bool skip_undeliverable_(Subscriber& sub) const;
 
-        private:
-            size_t payload_alloc_;
-            id_t sig_id_;
-            payload_t* payload_;
-        };
+        // Not thread safe.
+        // Return true if a signal can be queued without overwriting
+        // a signal that a subscriber has yet to read. Sets write_full_
+        // if not.
+        //
+        bool has_space_(void) const;
 
-        std::set<Subscriber*> read_notifiers_;
+        // Wait, with read_ready_mutex_ locked through lock, until
+        // has_space_() returns true. Return false if overflow_ is
+        // overflow_t::reject, nonblock is true, or overflow_timeout_
+        // expires.
+        //
+        bool wait_for_space_(std::unique_lock<mutex_t>& lock, const bool nonblock);
 
-        mutable std::mutex read_ready_mutex_;
-        mutable std::condition_variable read_ready_cond_;
+        // Not thread safe.
+        // Wake up publishers waiting for space after subscribers
+        // have read signals. Only done once a queue found to be full
+        // by has_space_() has space again. Has no effect with
+        // overflow_t::overwrite.
+        //
+        // Return true if notify_write_ready_() is to be called once
+        // read_ready_mutex_ has been unlocked.
+        //
+        inline bool write_ready_(void) const;
 
-        mutable std::mutex read_notifiers_mutex_;
+        // Call queue_write_ready() on all write notifiers. Called
+        // with read_ready_mutex_ unlocked, so that readers and
+        // publishers are not held up by the notifiers.
+        //
+        inline void notify_write_ready_(void) const;
+
+        // Not thread safe.
+        // Move sub to its newest signals if it lags behind more than
+        // its lag policy allows. Return the number of signals skipped.
+        //
+        inline signal_count_t apply_lag_policy_(Subscriber& sub) const;
+
+        // Wait for a signal to be ready. See queue_impl.hh
+        inline bool wait_for_signal_(Subscriber& sub,
+                                     std::unique_lock<mutex_t>& lock,
+                                     signal_count_t& lost_signal_count) const;
+
+    private:
+        //
+        // The members are grouped by the threads writing them, with
+        // each group starting on its own cache line, so that
+        // publishers and subscribers running on different cores do
+        // not invalidate each other's lines.
+        //
+
+        // Set up by the constructor. Read only after that.
+        const std::uint64_t id_;
+        const bool on_change_;
+        const overflow_t overflow_;
+        const std::uint64_t overflow_timeout_; // Nanoseconds
+        StoragePolicy queue_;
+        index_t queue_mask_;
+
+        // Written by every thread taking the lock.
+        alignas(cache_line_size) mutable mutex_t read_ready_mutex_;
+        mutable cond_t read_ready_cond_;
+        mutable cond_t write_ready_cond_; // Publishers waiting for space
+
+        // Written by publishers with read_ready_mutex_ locked.
+        alignas(cache_line_size) signal_id_t next_sig_id_; // Monotonic transaction id.
+        index_t head_;
+        index_t tail_;
+        Counter signals_published_;
+        Counter bytes_published_;
+        Counter signals_suppressed_;
+        std::uint32_t last_crc_; // CRC32C of the last payload published, if on_change_.
+        Counter signals_rejected_;
+        mutable signal_id_t min_sub_sig_id_; // Lower bound of the subscribers' sig_id(). Also lowered by seek().
+        mutable bool write_full_; // has_space_() returned false, and no writer has been notified since.
+        int writers_waiting_;
+
+        // Written by subscribers with read_ready_mutex_ locked.
+        alignas(cache_line_size) mutable Counter signals_lost_;
+        mutable Counter peak_occupancy_;
 
         // Conditional variable setup used to
         // ensure that subscriber threads always have priority
@@ -284,11 +485,382 @@ namespace sigfs {
 //        mutable std::condition_variable prio_cond_;
         mutable int active_subscribers_;
 
-        signal_id_t next_sig_id_; // Monotonic transaction id.
-        std::vector< Signal > queue_;
-        index_t queue_mask_;
-        index_t head_;
-        index_t tail_;
+        // Written when files are opened and closed.
+        // subscribers_ holds all reading subscribers. Protected by
+        // read_ready_mutex_
+        alignas(cache_line_size) std::set<Subscriber*> subscribers_;
+        mutable std::mutex read_notifiers_mutex_;
+        std::set<Subscriber*> read_notifiers_;
+        mutable std::mutex write_notifiers_mutex_;
+        std::set<Subscriber*> write_notifiers_;
+
+        // Recorded by readers without any lock held.
+        alignas(cache_line_size) Histogram delivery_latency_;
+    };
+
+    // Instantiated in queue.cc
+    extern template class QueueEngine<MutexSync, HeapStorage>;
+    extern template class QueueEngine<MutexSync, ArenaStorage>;
+    extern template class QueueEngine<SpinSync, HeapStorage>;
+    extern template class QueueEngine<SpinSync, ArenaStorage>;
+    extern template class QueueEngine<MutexSync, InlineStorage>;
+    extern template class QueueEngine<SpinSync, InlineStorage>;
+
+
+    // Queue engine selection.
+    //
+    struct QueueConfig {
+        enum class sync_t { mutex, spin };
+        enum class storage_t { heap, arena, inline_slot };
+
+        sync_t sync = sync_t::mutex;
+        storage_t storage = storage_t::heap;
+
+        // Payload bytes per slot for storage_t::arena.
+        std::uint32_t slot_size = 64;
+
+        // Huge pages, locking and NUMA placement of the queue
+        // slots. Not used by storage_t::heap.
+        QueueMemory::Options memory;
+
+        // Drop signals whose payload is identical to that of the
+        // previously published signal, so that subscribers are only
+        // woken up when the payload changes.
+        bool on_change = false;
+
+        // What to do when the queue is full. overflow_timeout is the
+        // longest time, in nanoseconds, that overflow_t::block
+        // waits for space.
+        QueueBase::overflow_t overflow = QueueBase::overflow_t::overwrite;
+        std::uint64_t overflow_timeout = 100000000;
+
+        // Parse a sync / storage policy name, as listed by the
+        // policy's name member. Return false if name is unknown.
+        //
+        static bool parse_sync(const std::string& name, sync_t& res);
+        static bool parse_storage(const std::string& name, storage_t& res);
+
+        // Parse "overwrite", "block", or "eagain" (overflow_t::reject).
+        static bool parse_overflow(const std::string& name, QueueBase::overflow_t& res);
+
+        const char* sync_name(void) const;
+        const char* storage_name(void) const;
+        const char* overflow_name(void) const;
+    };
+
+
+    //
+    // Thread safe circular queue with loss detection.
+    //
+    // Forwards all calls to the QueueEngine specialization selected
+    // by the QueueConfig given to the constructor.
+    //
+    class Queue: public QueueBase {
+    private:
+        // Invoke f with the engine.
+        //
+        // Defined ahead of the forwarding methods below, which need
+        // its deduced return type.
+        //
+        template<typename F>
+        inline decltype(auto) visit(F&& f) const {
+            return std::visit([&f](auto& engine) -> decltype(auto) { return f(*engine); }, engine_);
+        }
+
+    public:
+        using Config = QueueConfig;
+
+        // length has to be a power of 2:
+        // 2 4 8 16 32, 64, 128, etc
+        //
+        // id is reported by trace probes to identify the queue.
+        // sigfs uses the inode of the signal file.
+        //
+        // config selects the sync and storage policies of the queue.
+        //
+        Queue(const index_t queue_length,
+              const std::uint64_t id = 0,
+              const Config& config = Config());
+        ~Queue(void);
+
+        inline const Config& config(void) const {
+            return config_;
+        }
+
+
+        // Queue data as a signal on queue.
+        //
+        // With Config::on_change set, data is dropped if it is
+        // identical to the payload of the previous signal.
+        //
+        // Unless Config::overflow is overflow_t::overwrite, the
+        // oldest signal is not overwritten until all subscribers have
+        // read it. If the queue is full, false is returned without
+        // queuing data, either at once with overflow_t::reject or
+        // nonblock set, or once Config::overflow_timeout has expired
+        // with overflow_t::block.
+        //
+        inline bool queue_signal(const char* data, const size_t data_sz, const bool nonblock = false) {
+            if (!visit([&](auto& engine) { return engine.queue_signal(data, data_sz, nonblock); }))
+                return false;
+
+            if (has_aggregators_.load(std::memory_order_relaxed))
+                aggregate_(data, data_sz);
+
+            return true;
+        }
+
+        // Have each signal queued handed to aggregator, which
+        // publishes the aggregate of the signals to its own target
+        // queue. Signals dropped by Config::on_change are handed to
+        // aggregator as well.
+        //
+        void add_aggregator(std::shared_ptr<Aggregator> aggregator);
+
+        //
+        // Retrieve the data of the next signal for us to read.
+        //
+        // For each signal processed, the cb callback will be invoked.
+        // If cb returns true, and there are additional signals to be processed,
+        // cb will be called again until either there are no more signals or
+        // cb returns false.
+        //
+        // Having cb called multiple times speeds up processing since all callbacks
+        // are done with the relevant resoruces mutex-locked only once at the beginning
+        // of the dequeue_signal() call.
+        //
+        // If not signal is available, this method will block until
+        // another thread calls queue_signal().
+        //
+        // See below for instructions on how to interrupt this call.
+        //
+        template<typename CallbackT=void*>
+        bool dequeue_signal(Subscriber& sub,
+                            CallbackT userdata,
+                            signal_callback_t<CallbackT>& cb) const;
+
+        //
+        // Same as dequeue_signal() above, but with cb being any
+        // callable object taking the signal_callback_t arguments
+        // except userdata:
+        //
+        //   cb_result_t cb(signal_id_t signal_id,
+        //                  const char* payload,
+        //                  std::uint32_t payload_size,
+        //                  signal_count_t lost_signals,
+        //                  signal_count_t remaining_signal_count,
+        //                  std::uint64_t publish_time);
+        //
+        // Since the type of cb is known at compile time, the
+        // compiler can inline it into the per-signal loop instead of
+        // making an indirect call through std::function for each
+        // signal. Use this version on hot paths.
+        //
+        template<typename F>
+        bool dequeue_signal(Subscriber& sub, F&& cb) const;
+
+        //
+        // Retrieve up to max_count, and at most SignalBatch::max_size,
+        // signals ready to be read by sub with a single call to cb:
+        //
+        //   std::size_t cb(const SignalBatch& batch);
+        //
+        // cb returns the number of signals, counted from the start of
+        // the batch, that it processed. sub is moved past these
+        // signals, and any remaining signals of the batch are
+        // delivered again by the next call. Signals lost before the
+        // batch are reported by batch.lost_signals() once, even if
+        // cb processes no signals.
+        //
+        // Like dequeue_signal(), this method blocks until at least one
+        // signal is available. If interrupted, cb is called with an
+        // empty batch and false is returned.
+        //
+        template<typename F>
+        bool dequeue_signals(Subscriber& sub, std::size_t max_count, F&& cb) const;
+
+        //
+        // Interrupt an ongoing dequeue_signal() call that is
+        // blocking.
+        //
+        // This will cause all threads currently blocking on
+        // dequeue_signal() to invoke cb with the payload argumentset
+        // to NULL and payload_size set to 0. After cb returns,
+        // dequeue_signal() will return.
+        //
+        // cb will only be called once to deliver the interrupt
+        // notification, even if the single_callback argument to
+        // dequeue_signal() is set to false.
+        //
+        inline void interrupt_dequeue(Subscriber& sub) {
+            visit([&](auto& engine) { engine.interrupt_dequeue(sub); });
+        }
+
+        // Install filter as the filter of sub. Signals not
+        // matching the filter are skipped by dequeue_signal() and
+        // dequeue_signals() and counted by
+        // SubscriberStats::signals_filtered.
+        //
+        inline void set_filter(Subscriber& sub, const SignalFilter& filter) {
+            visit([&](auto& engine) { engine.set_filter(sub, filter); });
+        }
+
+        // Install rate as the rate limit of sub. Signals passed over
+        // by the rate limit are reported by SignalRef::signals_skipped
+        // and counted by SubscriberStats::signals_skipped, but not
+        // reported as lost.
+        //
+        inline void set_rate(Subscriber& sub, const DeliveryRate& rate) {
+            visit([&](auto& engine) { engine.set_rate(sub, rate); });
+        }
+
+        // Install lag as the lag policy of sub. If sub has more than
+        // lag.max_lag() signals to read when dequeue_signal() or
+        // dequeue_signals() is called, it is moved to its
+        // lag.keep() newest signals first. Signals passed over are
+        // counted by SubscriberStats::signals_skipped and, for
+        // dequeue_signals(), reported by SignalRef::signals_skipped.
+        //
+        inline void set_lag(Subscriber& sub, const LagPolicy& lag) {
+            visit([&](auto& engine) { engine.set_lag(sub, lag); });
+        }
+
+        // Move sub so that its next read starts with:
+        //
+        //   seek_t::signal_id - The signal with id value. 0, which
+        //                       no signal has, is taken as oldest.
+        //   seek_t::oldest    - The oldest signal in the queue. value is ignored.
+        //   seek_t::newest    - The last value signals published. 0
+        //                       skips all signals published so far.
+        //
+        // Positions past the next signal to be published are moved
+        // back to it. If the requested signals have been overwritten,
+        // sub is moved to the oldest signal in the queue and
+        // lost_signals is set to the number of signals missing.
+        // The rate limit state of sub is reset.
+        //
+        // Return the id of the next signal to be read by sub.
+        //
+        inline signal_id_t seek(Subscriber& sub,
+                                const seek_t whence,
+                                const std::uint64_t value,
+                                signal_count_t& lost_signals) {
+            return visit([&](auto& engine) { return engine.seek(sub, whence, value, lost_signals); });
+        }
+
+        // Return the number of signals available through
+        // dequeue_signal() calls.
+        //
+        inline const signal_count_t signal_available(const Subscriber& sub) const {
+            return visit([&](auto& engine) { return engine.signal_available(sub); });
+        }
+
+        // Return true if queue_signal() can queue a signal without
+        // waiting or being rejected. Always true with
+        // overflow_t::overwrite.
+        //
+        inline bool write_space_available(void) const {
+            return visit([&](auto& engine) { return engine.write_space_available(); });
+        }
+
+        // Return the time, on the timestamp() clock, when a signal
+        // held back by the minimum interval of sub's rate limit can
+        // be read. Return 0 if no signal is held back.
+        //
+        inline std::uint64_t signal_held_until(const Subscriber& sub) const {
+            return visit([&](auto& engine) { return engine.signal_held_until(sub); });
+        }
+
+        // Set publish_time to the publish time of the signal that
+        // the next dequeue_signal() call would deliver to sub, without
+        // moving sub. The filter and rate limit of sub are not
+        // applied. Return false if no signal is available.
+        //
+        inline bool peek_signal(const Subscriber& sub, std::uint64_t& publish_time) const {
+            return visit([&](auto& engine) { return engine.peek_signal(sub, publish_time); });
+        }
+
+        inline index_t queue_length(void) const {
+            return visit([](auto& engine) { return engine.queue_length(); });
+        }
+
+        inline std::uint64_t id(void) const {
+            return visit([](auto& engine) { return engine.id(); });
+        }
+
+        inline void dump(const char* prefix, const Subscriber& sub) {
+            visit([&](auto& engine) { engine.dump(prefix, sub); });
+        }
+
+        inline const signal_id_t tail_sig_id(void) const {
+            return visit([](auto& engine) { return engine.tail_sig_id(); });
+        }
+
+        // Set the subscriber's read position to the next signal to be
+        // published, and register it as a reader of the queue if
+        // sub.is_reader() is true.
+        //
+        inline void initialize_subscriber(Subscriber& sub) {
+            visit([&](auto& engine) { engine.initialize_subscriber(sub); });
+        }
+
+        // Unregister a subscriber previously setup by initialize_subscriber()
+        inline void release_subscriber(Subscriber& sub) {
+            visit([&](auto& engine) { engine.release_subscriber(sub); });
+        }
+
+        // Retrieve a snapshot of the queue statistics.
+        inline Stats statistics(void) const {
+            return visit([](auto& engine) { return engine.statistics(); });
+        }
+
+        // Publish-to-delivery latency, in nanoseconds, of all signals
+        // read from the queue. Recorded by the reader once a signal
+        // has been handed over to the subscribing process.
+        //
+        inline Histogram& delivery_latency(void) {
+            return visit([](auto& engine) -> Histogram& { return engine.delivery_latency(); });
+        }
+
+        inline const Histogram& delivery_latency(void) const {
+            return visit([](auto& engine) -> const Histogram& { return engine.delivery_latency(); });
+        }
+
+
+        inline void subscribe_read_ready_notifications(Subscriber* subscriber) {
+            visit([&](auto& engine) { engine.subscribe_read_ready_notifications(subscriber); });
+        }
+
+        inline void unsubscribe_read_ready_notifications(Subscriber* subscriber) {
+            visit([&](auto& engine) { engine.unsubscribe_read_ready_notifications(subscriber); });
+        }
+
+        // Have Subscriber::queue_write_ready() called on subscriber
+        // when subscribers have read signals, making room for
+        // publishers. Only done unless Config::overflow is
+        // overflow_t::overwrite.
+        //
+        inline void subscribe_write_ready_notifications(Subscriber* subscriber) {
+            visit([&](auto& engine) { engine.subscribe_write_ready_notifications(subscriber); });
+        }
+
+        inline void unsubscribe_write_ready_notifications(Subscriber* subscriber) {
+            visit([&](auto& engine) { engine.unsubscribe_write_ready_notifications(subscriber); });
+        }
+
+    private:
+        void aggregate_(const char* data, const size_t data_sz);
+
+        const Config config_;
+        std::atomic<bool> has_aggregators_;
+        std::mutex aggregators_mutex_;
+        std::vector<std::shared_ptr<Aggregator>> aggregators_;
+        std::variant<std::unique_ptr<QueueEngine<MutexSync, HeapStorage>>,
+                     std::unique_ptr<QueueEngine<MutexSync, ArenaStorage>>,
+                     std::unique_ptr<QueueEngine<SpinSync, HeapStorage>>,
+                     std::unique_ptr<QueueEngine<SpinSync, ArenaStorage>>,
+                     std::unique_ptr<QueueEngine<MutexSync, InlineStorage>>,
+                     std::unique_ptr<QueueEngine<SpinSync, InlineStorage>>> engine_;
     };
 }
 #endif // __SIGFS_QUEUE__
@@ -14,19 +14,49 @@
 
 namespace sigfs {
     template<typename CallbackT>
-
-    // Called by multiple different threads, each processing their own
-    // sigfs.cc::do_read() call to read a signal for a specific file descriptor.
-    //
-    // Return true if we were not interrupted.
-    // Return false if we were interrupted.
     bool Queue::dequeue_signal(Subscriber& sub,
                                CallbackT userdata,
                                signal_callback_t<CallbackT>& cb) const
     {
+        return dequeue_signal(sub,
+                              [userdata, &cb](signal_id_t signal_id,
+                                              const char* payload,
+                                              std::uint32_t payload_size,
+                                              signal_count_t lost_signals,
+                                              signal_count_t remaining_signal_count,
+                                              std::uint64_t publish_time) -> cb_result_t {
+                                  return cb(userdata, signal_id, payload, payload_size,
+                                            lost_signals, remaining_signal_count, publish_time);
+                              });
+    }
 
-        SIGFS_LOG_DEBUG("dequeue_signal(): Called", sub.sig_id());
+    template<typename F>
+    bool Queue::dequeue_signal(Subscriber& sub, F&& cb) const
+    {
+        return visit([&](auto& engine) { return engine.dequeue_signal(sub, std::forward<F>(cb)); });
+    }
 
+    template<typename F>
+    bool Queue::dequeue_signals(Subscriber& sub, std::size_t max_count, F&& cb) const
+    {
+        return visit([&](auto& engine) { return engine.dequeue_signals(sub, max_count, std::forward<F>(cb)); });
+    }
+
+    // Wait, with read_ready_mutex_ locked through lock, until a signal
+    // is ready to be read by sub or sub is interrupted.
+    //
+    // If the signals sub was about to read have been overwritten,
+    // sub is moved to the oldest signal in the queue and the number
+    // of signals lost is added to lost_signal_count.
+    //
+    // Return true if a signal is ready.
+    // Return false if we were interrupted.
+    //
+    template<typename SyncPolicy, typename StoragePolicy>
+    inline bool QueueEngine<SyncPolicy, StoragePolicy>::wait_for_signal_(Subscriber& sub,
+                                                                         std::unique_lock<mutex_t>& lock,
+                                                                         signal_count_t& lost_signal_count) const
+    {
         // Have we lost signals?
         // We have the sig_id of currently stored signal in queue[index(sub->sig_id())].sig_id()
         // We havne the ID of the next signal to process is in sub->sig_id()
@@ -34,7 +64,6 @@ namespace sigfs {
         // If the current id == next_id, then the signal is ready to read
         // If the current id > next_id then we have lost signals.
         //
-        signal_count_t lost_signal_count = 0;
 
         /*
           {
@@ -47,7 +76,7 @@ namespace sigfs {
         // Wait for a signal to become ready.
         //
 
-        const Queue& self(*this);
+        const QueueEngine& self(*this);
         auto check =
             [&self, &sub] {
                 //
@@ -90,41 +119,235 @@ namespace sigfs {
                 return true;
             };
 
-        {
-            std::unique_lock<std::mutex> lock(read_ready_mutex_);
-            SIGFS_LOG_DEBUG("dequeue_signal(): Lock acquired");
+        // A signal held back by the minimum interval of sub is
+        // delivered once the interval is up, or re-evaluated once a
+        // new signal is published.
+        //
+        const signal_id_t seen_sig_id(next_sig_id_);
+        auto ready =
+            [&self, &sub, &check, seen_sig_id] {
+                if (!check())
+                    return false;
 
-            // Wait for condition to be fulfilled.
-            read_ready_cond_.wait(lock, check);
+                return sub.is_interrupted() ||
+                    self.next_sig_id_ != seen_sig_id ||
+                    !held_(sub, sub.rate_state());
+            };
 
-            SIGFS_LOG_DEBUG("dequeue_signal(): condition signalled");
-            // Were we interrupted?
-            if (sub.is_interrupted()) {
-                (void) cb( userdata, 0, 0, 0, 0, 0);
-                return false;
-            }
+        // Let publishers waiting for sub to read signals know about
+        // the signals it has read so far before we go to sleep.
+        if (overflow_ != overflow_t::overwrite && !check() && write_ready_()) {
+            lock.unlock();
+            notify_write_ready_();
+            lock.lock();
+        }
+
+        // Wait for condition to be fulfilled.
+        SIGFS_TRACE3(dequeue_wait_start, id_, sub.sig_id(), sub.sub_id());
+        while(!ready()) {
+            const std::uint64_t next_time(sub.rate_state().next_time);
+            const std::uint64_t now(timestamp());
+
+            if (sub.rate().min_interval() && now < next_time)
+                read_ready_cond_.wait_for(lock, std::chrono::nanoseconds(next_time - now));
+            else
+                read_ready_cond_.wait(lock);
+        }
+        SIGFS_TRACE3(dequeue_wake, id_, sub.sig_id(), sub.sub_id());
 
+        SIGFS_LOG_DEBUG("dequeue_signal(): condition signalled");
+        // Were we interrupted?
+        if (sub.is_interrupted())
+            return false;
+
+        //
+        // If the ID of the oldest signal in the queue (tail()) is
+        // greater than the next signal we expect to read (sub.sig_id()), then
+        // we have lost signals
+        //
+        // Update subscriber's sig_id to the oldest signal in the queue.
+        //
+        if (self.queue_[tail()].sig_id() > sub.sig_id()) {
+            SIGFS_LOG_DEBUG("dequeue_signal(): Tail catchup for [%lu] lost signals [%lu]->[%lu]",
+                            queue_[tail()].sig_id() - sub.sig_id(),
+                            sub.sig_id(),
+                            queue_[tail()].sig_id());
             //
-            // If the ID of the oldest signal in the queue (tail()) is
-            // greater than the next signal we expect to read (sub.sig_id()), then
-            // we have lost signals
+            // sub.sig_id() is for the next signal we are expecting.
+            // queue_[tail()].sig_id() is the signal currently stored in the queue slot
+            // we are about to read the signal from.
             //
-            // Update subscriber's sig_id to the oldest signal in the queue.
+            const signal_count_t lost(self.queue_[tail()].sig_id() - sub.sig_id());
+
+            lost_signal_count += lost;
+            sub.set_sig_id(tail_sig_id_());
+            sub.count_lost(lost);
+            signals_lost_.add(lost);
+            SIGFS_TRACE4(signals_lost, id_, sub.sig_id(), sub.sub_id(), lost);
+        }
+        return true;
+    }
+
+
+    template<typename SyncPolicy, typename StoragePolicy>
+    inline signal_id_t QueueEngine<SyncPolicy, StoragePolicy>::next_deliverable_(const Subscriber& sub,
+                                                                                  signal_id_t id,
+                                                                                  const DeliveryRate::state_t& state,
+                                                                                  signal_count_t& filtered,
+                                                                                  signal_count_t& skipped) const
+    {
+        const SignalFilter& filter(sub.filter());
+        const DeliveryRate& rate(sub.rate());
+        auto match =
+            [this, &filter](const signal_id_t id) {
+                const auto& sig(queue_[index(id)]);
+
+                return filter.match(sig.payload()->payload, sig.payload()->payload_size);
+            };
+
+        if (filter.empty() && rate.empty())
+            return id;
+
+        // Decimation. Jump straight to the next signal to deliver
+        // without looking at the signals in between.
+        //
+        if (id < state.next_id) {
+            const signal_id_t next_id((state.next_id < next_sig_id_)?state.next_id:next_sig_id_);
+
+            skipped += next_id - id;
+            id = next_id;
+        }
+
+        if (rate.min_interval() && id != next_sig_id_) {
+            // Deliver the newest signal passing the filter. If the
+            // interval is not yet up, it is held back by held_()
+            // until it is, unless a newer signal replaces it.
             //
-            if (self.queue_[tail()].sig_id() > sub.sig_id()) {
-                SIGFS_LOG_DEBUG("dequeue_signal(): Tail catchup for [%lu] lost signals [%lu]->[%lu]",
-                                queue_[tail()].sig_id() - sub.sig_id(),
-                                sub.sig_id(),
-                                queue_[tail()].sig_id());
-                //
-                // sub.sig_id() is for the next signal we are expecting.
-                // queue_[tail()].sig_id() is the signal currently stored in the queue slot
-                // we are about to read the signal from.
-                //
-                lost_signal_count = self.queue_[tail()].sig_id() - sub.sig_id();
-                sub.set_sig_id(tail_sig_id_());
+            signal_id_t newest(next_sig_id_ - 1);
+
+            while(newest != id && !match(newest))
+                --newest;
+
+            if (!match(newest)) {
+                filtered += next_sig_id_ - id;
+                return next_sig_id_;
             }
 
+            skipped += newest - id;
+            return newest;
+        }
+
+        while(id != next_sig_id_ && !match(id)) {
+            ++filtered;
+            ++id;
+        }
+        return id;
+    }
+
+
+    template<typename SyncPolicy, typename StoragePolicy>
+    inline bool QueueEngine<SyncPolicy, StoragePolicy>::held_(const Subscriber& sub,
+                                                             const DeliveryRate::state_t& state)
+    {
+        return sub.rate().min_interval() && timestamp() < state.next_time;
+    }
+
+
+    template<typename SyncPolicy, typename StoragePolicy>
+    inline bool QueueEngine<SyncPolicy, StoragePolicy>::skip_undeliverable_(Subscriber& sub) const
+    {
+        signal_count_t filtered(0);
+        signal_count_t skipped(0);
+        const signal_id_t id(next_deliverable_(sub, sub.sig_id(), sub.rate_state(), filtered, skipped));
+
+        if (id != sub.sig_id()) {
+            sub.count_filtered(filtered);
+            sub.count_skipped(skipped);
+            sub.set_sig_id(id);
+        }
+        return id != next_sig_id_ && !held_(sub, sub.rate_state());
+    }
+
+
+    template<typename SyncPolicy, typename StoragePolicy>
+    inline bool QueueEngine<SyncPolicy, StoragePolicy>::write_ready_(void) const
+    {
+        // Nobody can be waiting for space unless has_space_()
+        // has reported the queue as full.
+        if (overflow_ == overflow_t::overwrite || !write_full_ || !has_space_())
+            return false;
+
+        write_full_ = false;
+
+        if (writers_waiting_)
+            write_ready_cond_.notify_all();
+
+        return true;
+    }
+
+
+    template<typename SyncPolicy, typename StoragePolicy>
+    inline void QueueEngine<SyncPolicy, StoragePolicy>::notify_write_ready_(void) const
+    {
+        std::lock_guard<std::mutex> lock(write_notifiers_mutex_);
+        for(auto iter: write_notifiers_)
+            iter->queue_write_ready();
+    }
+
+
+    template<typename SyncPolicy, typename StoragePolicy>
+    inline signal_count_t QueueEngine<SyncPolicy, StoragePolicy>::apply_lag_policy_(Subscriber& sub) const
+    {
+        const LagPolicy& lag(sub.lag());
+
+        if (lag.empty() || next_sig_id_ - sub.sig_id() <= lag.max_lag())
+            return 0;
+
+        const signal_count_t skipped(next_sig_id_ - lag.keep() - sub.sig_id());
+
+        SIGFS_LOG_DEBUG("apply_lag_policy_(): Subscriber [%d] skipped [%u] signals",
+                        sub.sub_id(), skipped);
+        sub.count_skipped(skipped);
+        sub.set_sig_id(next_sig_id_ - lag.keep());
+        return skipped;
+    }
+
+
+    template<typename SyncPolicy, typename StoragePolicy>
+    template<typename F>
+
+    // Called by multiple different threads, each processing their own
+    // sigfs.cc::do_read() call to read a signal for a specific file descriptor.
+    //
+    // Return true if we were not interrupted.
+    // Return false if we were interrupted.
+    bool QueueEngine<SyncPolicy, StoragePolicy>::dequeue_signal(Subscriber& sub, F&& cb) const
+    {
+        SIGFS_LOG_DEBUG("dequeue_signal(): Called", sub.sig_id());
+
+        signal_count_t lost_signal_count = 0;
+        const QueueEngine& self(*this);
+        bool write_ready(false);
+
+        {
+            std::unique_lock<mutex_t> lock(read_ready_mutex_);
+            SIGFS_LOG_DEBUG("dequeue_signal(): Lock acquired");
+
+            // Wait until a signal passing the filter and rate limit
+            // of sub is ready.
+            do {
+                if (!wait_for_signal_(sub, lock, lost_signal_count)) {
+                    (void) cb(0, 0, 0, 0, 0, 0);
+                    return false;
+                }
+
+                apply_lag_policy_(sub);
+            } while(!skip_undeliverable_(sub));
+
+            // Number of signals waiting to be read by this subscriber.
+            peak_occupancy_.track_max(next_sig_id_ - sub.sig_id());
+            std::uint32_t delivered = 0;
+
             while(true) {
                 //
                 // We do the callback since signal is protected by read_ready_mutex_.
@@ -141,30 +364,47 @@ namespace sigfs {
                 //
                 SIGFS_LOG_DEBUG("dequeue_signal(): Doing callback with %lu bytes.",
                                 queue_[index(sub.sig_id())].payload()->payload_size);
-                cb_result_t cb_res = cb( userdata,
-                                         sub.sig_id(),
+                SIGFS_TRACE4(dequeue_callback, id_, sub.sig_id(), sub.sub_id(),
+                             queue_[index(sub.sig_id())].payload()->payload_size);
+                cb_result_t cb_res = cb( sub.sig_id(),
                                          queue_[index(sub.sig_id())].payload()->payload,
                                          queue_[index(sub.sig_id())].payload()->payload_size,
                                          lost_signal_count,
-                                         self.next_sig_id_ - sub.sig_id() - 1);
+                                         self.next_sig_id_ - sub.sig_id() - 1,
+                                         queue_[index(sub.sig_id())].publish_time());
 
 
                 //
                 // Did we successfully process the signal?
                 //
                 if (cb_res != cb_result_t::not_processed) {
+                    if (!sub.rate().empty())
+                        sub.set_rate_state(sub.rate().next(sub.sig_id(), timestamp()));
+
                     sub.set_sig_id(sub.sig_id() + 1);
+                    ++delivered;
+
+                    // Lost signals are reported with the first signal
+                    // delivered after the loss only.
+                    lost_signal_count = 0;
                 }
 
                 //
                 // Do we process more signals or do we break out of the loop?
                 //
                 if (cb_res != cb_result_t::processed_call_again ||
-                    !signal_available_(sub)) {
+                    !signal_available_(sub) ||
+                    !skip_undeliverable_(sub)) {
                     break;
                 }
             }
+            sub.count_delivered(delivered);
+            write_ready = write_ready_();
         }
+
+        if (write_ready)
+            notify_write_ready_();
+
         //
         // Decrease active subscribers and check if there are no other subscribers waiting.
         // If that is the case, signal all threads waiting in queue_signal() that they
@@ -185,5 +425,140 @@ namespace sigfs {
 
         return true; // Not interrupted.
     }
+
+
+    template<typename SyncPolicy, typename StoragePolicy>
+    template<typename F>
+    bool QueueEngine<SyncPolicy, StoragePolicy>::dequeue_signals(Subscriber& sub,
+                                                                 std::size_t max_count,
+                                                                 F&& cb) const
+    {
+        SignalBatch batch;
+
+        if (max_count > SignalBatch::max_size)
+            max_count = SignalBatch::max_size;
+
+        // The wait below does not return until the batch has at
+        // least one signal.
+        if (!max_count)
+            max_count = 1;
+
+        std::unique_lock<mutex_t> lock(read_ready_mutex_);
+        const DeliveryRate& rate(sub.rate());
+        signal_id_t scan_end;
+
+        // Signals passed over by the filter and rate limit of sub.
+        // The *_before arrays hold the counts up to each signal of
+        // the batch.
+        //
+        signal_count_t filtered;
+        signal_count_t skipped;
+        signal_count_t filtered_before[SignalBatch::max_size];
+        signal_count_t skipped_before[SignalBatch::max_size];
+
+        // Skipped while waiting for a signal to deliver.
+        signal_count_t skipped_waiting(0);
+
+        // Wait until a signal passing the filter and rate limit of
+        // sub is ready.
+        do {
+            if (!wait_for_signal_(sub, lock, batch.lost_signals_)) {
+                (void) cb(batch);
+                return false;
+            }
+
+            skipped_waiting += apply_lag_policy_(sub);
+
+            // Number of signals waiting to be read by this subscriber.
+            peak_occupancy_.track_max(next_sig_id_ - sub.sig_id());
+
+            // The slots between sub.sig_id() and next_sig_id_ are
+            // consecutive signals, since the wait above moved sub up
+            // to the tail if it had fallen behind.
+            //
+            // Collect the signals to deliver. Without a filter or
+            // rate limit, this is the first max_count signals.
+            //
+            DeliveryRate::state_t state(sub.rate_state());
+
+            filtered = 0;
+            skipped = 0;
+            scan_end = sub.sig_id();
+
+            while(batch.size_ < max_count) {
+                const signal_count_t skipped_start(skipped);
+
+                scan_end = next_deliverable_(sub, scan_end, state, filtered, skipped);
+
+                if (scan_end == next_sig_id_ || held_(sub, state))
+                    break;
+
+                const auto& sig(queue_[index(scan_end)]);
+
+                filtered_before[batch.size_] = filtered;
+                skipped_before[batch.size_] = skipped;
+                batch.signals_[batch.size_++] = {
+                    .signal_id = scan_end,
+                    .payload = sig.payload()->payload,
+                    .payload_size = sig.payload()->payload_size,
+                    .publish_time = sig.publish_time(),
+                    .signals_skipped = skipped - skipped_start
+                };
+                SIGFS_TRACE4(dequeue_callback, id_, scan_end, sub.sub_id(),
+                             sig.payload()->payload_size);
+
+                if (!rate.empty())
+                    state = rate.next(scan_end, sig.publish_time());
+
+                ++scan_end;
+            }
+
+            // Nothing to deliver. Skip the scanned signals and wait
+            // for more.
+            //
+            if (batch.empty()) {
+                sub.count_filtered(filtered);
+                sub.count_skipped(skipped);
+                sub.set_sig_id(scan_end);
+                skipped_waiting += skipped;
+            }
+        } while(batch.empty());
+
+        batch.signals_[0].signals_skipped += skipped_waiting;
+
+        // Remaining signals are not filtered, and may include
+        // signals that will be skipped by the next call.
+        //
+        batch.remaining_ = next_sig_id_ - scan_end;
+
+        std::size_t processed(cb(const_cast<const SignalBatch&>(batch)));
+
+        if (processed > batch.size_)
+            processed = batch.size_;
+
+        // Move sub to the first unprocessed signal of the batch, or
+        // past all scanned signals if the entire batch was processed.
+        //
+        if (processed < batch.size_) {
+            sub.count_filtered(filtered_before[processed]);
+            sub.count_skipped(skipped_before[processed]);
+            sub.set_sig_id(batch.signals_[processed].signal_id);
+        } else {
+            sub.count_filtered(filtered);
+            sub.count_skipped(skipped);
+            sub.set_sig_id(scan_end);
+        }
+
+        if (processed && !rate.empty())
+            sub.set_rate_state(rate.next(batch.signals_[processed - 1].signal_id, timestamp()));
+
+        sub.count_delivered(processed);
+
+        if (write_ready_()) {
+            lock.unlock();
+            notify_write_ready_();
+        }
+        return true; // Not interrupted.
+    }
 }
 #endif // __SIGFS_QUEUE__
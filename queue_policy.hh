@@ -0,0 +1,505 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+//
+// Synchronization and storage policies for QueueEngine.
+//
+// A sync policy selects the lock that protects the queue and the
+// condition variable that readers block on:
+//
+//   MutexSync - std::mutex and std::condition_variable.
+//   SpinSync  - SpinLock and std::condition_variable_any. Cheaper
+//               than a mutex when the lock is held briefly and
+//               publishers and readers run on separate cores.
+//
+// A storage policy provides the queue slots. Each slot holds one
+// signal and provides payload(), sig_id(), publish_time(),
+// set_sig_id() and set():
+//
+//   HeapStorage  - Each slot has its own heap allocated payload,
+//                  grown as needed.
+//   ArenaStorage - All slots share a single allocation with a fixed
+//                  number of payload bytes per slot. Larger payloads
+//                  are allocated on the heap for the slot.
+//   InlineStorage - Each slot is a single cache line holding the
+//                  signal header and up to InlineStorage::inline_size
+//                  payload bytes. Larger payloads are allocated on
+//                  the heap for the slot.
+//
+// ArenaStorage and InlineStorage allocate their slots through
+// QueueMemory, which can back them with huge pages and lock them in
+// RAM. HeapStorage ignores the memory flags.
+//
+
+#ifndef __SIGFS_QUEUE_POLICY__
+#define __SIGFS_QUEUE_POLICY__
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+#include <cstdint>
+#include <new>
+#include <memory.h>
+#include "sigfs_common.h"
+
+namespace sigfs {
+
+    // Data written by different threads is kept this far apart to
+    // avoid false sharing.
+    static constexpr std::size_t cache_line_size = 64;
+
+    // Payload as stored in a queue slot.
+    typedef struct queue_payload_t_ {
+        uint32_t payload_size = 0; // Number of bytes in data.
+        char payload[];
+    } queue_payload_t;
+
+    // Anonymous memory mapping holding queue slots.
+    //
+    // Memory is zero filled. Defined in queue.cc
+    //
+    class QueueMemory {
+    public:
+        struct Options {
+            // Back the mapping with 2 MB huge pages from the
+            // hugetlbfs pool. If the pool is empty, a regular mapping
+            // is used with transparent huge pages requested through
+            // madvise().
+            bool huge_pages = false;
+
+            // Prefault the mapping and lock it in RAM. If the lock
+            // fails, typically because of RLIMIT_MEMLOCK, a warning
+            // is logged and the memory is left unlocked.
+            bool lock = false;
+
+            // NUMA node to allocate the pages from, if it has free
+            // memory. -1 for the node of the thread touching each
+            // page first.
+            int numa_node = -1;
+
+            inline bool is_default(void) const {
+                return !huge_pages && !lock && numa_node < 0;
+            }
+        };
+
+        QueueMemory(const size_t size, const Options& options);
+        ~QueueMemory(void);
+
+        QueueMemory(const QueueMemory&) = delete;
+        QueueMemory& operator=(const QueueMemory&) = delete;
+
+        inline char* data(void) const { return data_; }
+
+        // True if backed by hugetlbfs pages.
+        inline bool huge_pages(void) const { return huge_pages_; }
+
+        // True if locked in RAM.
+        inline bool locked(void) const { return locked_; }
+
+    private:
+        char* data_;
+        size_t mapped_size_;
+        bool huge_pages_;
+        bool locked_;
+    };
+
+
+    // Test-and-test-and-set spinlock.
+    //
+    // Yields the CPU after spinning for a while, so that a lock
+    // holder that has been preempted on the same core gets to run.
+    //
+    class SpinLock {
+    public:
+        inline void lock(void)
+        {
+            int spins = 0;
+
+            while(locked_.exchange(true, std::memory_order_acquire)) {
+                while(locked_.load(std::memory_order_relaxed)) {
+                    if (++spins < 128) {
+                        relax();
+                        continue;
+                    }
+                    std::this_thread::yield();
+                    spins = 0;
+                }
+            }
+        }
+
+        inline bool try_lock(void)
+        {
+            return !locked_.load(std::memory_order_relaxed) &&
+                !locked_.exchange(true, std::memory_order_acquire);
+        }
+
+        inline void unlock(void)
+        {
+            locked_.store(false, std::memory_order_release);
+        }
+
+    private:
+        static inline void relax(void)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+        std::atomic<bool> locked_ { false };
+    };
+
+
+    struct MutexSync {
+        static constexpr const char* name = "mutex";
+        using mutex_t = std::mutex;
+        using cond_t = std::condition_variable;
+    };
+
+    struct SpinSync {
+        static constexpr const char* name = "spin";
+        using mutex_t = SpinLock;
+        using cond_t = std::condition_variable_any;
+    };
+
+
+    class HeapStorage {
+    public:
+        static constexpr const char* name = "heap";
+
+        class Slot {
+        public:
+            Slot(void):
+                payload_alloc_(0),
+                sig_id_(0),
+                publish_time_(0),
+                payload_{}
+            {
+            }
+
+            ~Slot(void)
+            {
+                if (payload_)
+                    delete[] (char*) payload_;
+            }
+
+            inline const queue_payload_t* payload(void) const
+            {
+                return payload_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline const signal_id_t sig_id(void) const
+            {
+                return sig_id_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline std::uint64_t publish_time(void) const
+            {
+                return publish_time_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline void set_sig_id(const signal_id_t id)
+            {
+                sig_id_ = id;
+            }
+
+            inline void set(const signal_id_t sig_id,
+                            const std::uint64_t publish_time,
+                            const char* payload,
+                            const size_t payload_size)
+            {
+                // First time allocation?
+                if (payload_size + sizeof(sigfs_signal_t) > payload_alloc_) {
+                    if (payload_)
+                        delete[] (char*) payload_;
+
+                    payload_ = (queue_payload_t*) new  char[sizeof(queue_payload_t) + payload_size];
+                    payload_alloc_ = payload_size + sizeof(queue_payload_t);
+                }
+
+                payload_->payload_size = payload_size;
+                memcpy(payload_->payload, payload, payload_size);
+                sig_id_ = sig_id;
+                publish_time_ = publish_time;
+            }
+
+        private:
+            size_t payload_alloc_;
+            signal_id_t sig_id_;
+            std::uint64_t publish_time_;
+            queue_payload_t* payload_;
+        };
+
+        // slot_size and memory options are not used by this policy.
+        HeapStorage(const std::uint32_t length,
+                    const std::uint32_t slot_size,
+                    const QueueMemory::Options& memory):
+            slots_(length)
+        {
+        }
+
+        inline Slot& operator[](const std::uint32_t ind) { return slots_[ind]; }
+        inline const Slot& operator[](const std::uint32_t ind) const { return slots_[ind]; }
+        inline std::uint32_t size(void) const { return slots_.size(); }
+
+    private:
+        std::vector<Slot> slots_;
+    };
+
+
+    class ArenaStorage {
+    public:
+        static constexpr const char* name = "arena";
+
+        class Slot {
+        public:
+            Slot(void):
+                arena_(nullptr),
+                arena_size_(0),
+                overflow_size_(0),
+                sig_id_(0),
+                publish_time_(0),
+                payload_(nullptr)
+            {
+            }
+
+            ~Slot(void)
+            {
+                if (payload_ && payload_ != arena_)
+                    delete[] (char*) payload_;
+            }
+
+            inline const queue_payload_t* payload(void) const
+            {
+                return payload_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline const signal_id_t sig_id(void) const
+            {
+                return sig_id_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline std::uint64_t publish_time(void) const
+            {
+                return publish_time_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline void set_sig_id(const signal_id_t id)
+            {
+                sig_id_ = id;
+            }
+
+            inline void set(const signal_id_t sig_id,
+                            const std::uint64_t publish_time,
+                            const char* payload,
+                            const size_t payload_size)
+            {
+                if (payload_size <= arena_size_) {
+                    if (payload_ && payload_ != arena_) {
+                        delete[] (char*) payload_;
+                        overflow_size_ = 0;
+                    }
+                    payload_ = arena_;
+                }
+                else if (payload_size > overflow_size_) {
+                    // Too large for the arena. Use the heap.
+                    if (payload_ && payload_ != arena_)
+                        delete[] (char*) payload_;
+
+                    payload_ = (queue_payload_t*) new char[sizeof(queue_payload_t) + payload_size];
+                    overflow_size_ = payload_size;
+                }
+
+                payload_->payload_size = payload_size;
+                memcpy(payload_->payload, payload, payload_size);
+                sig_id_ = sig_id;
+                publish_time_ = publish_time;
+            }
+
+        private:
+            friend class ArenaStorage;
+
+            queue_payload_t* arena_;  // This slot's part of the arena.
+            std::uint32_t arena_size_;
+            std::uint32_t overflow_size_; // Allocated size of a heap payload.
+            signal_id_t sig_id_;
+            std::uint64_t publish_time_;
+            queue_payload_t* payload_;
+        };
+
+        // slot_size is the number of payload bytes per slot in the
+        // arena. The slots are followed by the arena in a single
+        // QueueMemory allocation.
+        //
+        ArenaStorage(const std::uint32_t length,
+                     const std::uint32_t slot_size,
+                     const QueueMemory::Options& memory):
+            length_(length),
+            // Keep each slot's payload header 8-byte aligned.
+            stride_((sizeof(queue_payload_t) + slot_size + 7) & ~(size_t) 7),
+            memory_(sizeof(Slot) * length + stride_ * length, memory),
+            slots_((Slot*) memory_.data())
+        {
+            char* arena(memory_.data() + sizeof(Slot) * length);
+
+            for(std::uint32_t ind = 0; ind < length; ++ind) {
+                new (&slots_[ind]) Slot();
+                slots_[ind].arena_ = (queue_payload_t*) (arena + stride_ * ind);
+                slots_[ind].arena_size_ = stride_ - sizeof(queue_payload_t);
+            }
+        }
+
+        ~ArenaStorage(void)
+        {
+            for(std::uint32_t ind = 0; ind < length_; ++ind)
+                slots_[ind].~Slot();
+        }
+
+        inline Slot& operator[](const std::uint32_t ind) { return slots_[ind]; }
+        inline const Slot& operator[](const std::uint32_t ind) const { return slots_[ind]; }
+        inline std::uint32_t size(void) const { return length_; }
+
+    private:
+        const std::uint32_t length_;
+        const size_t stride_;
+        QueueMemory memory_;
+        Slot* slots_;
+    };
+
+
+    class InlineStorage {
+    public:
+        static constexpr const char* name = "inline";
+
+        // Payload bytes stored in the slot itself. What is left of
+        // the cache line after the slot header.
+        static constexpr std::size_t inline_size = 32;
+
+        class alignas(cache_line_size) Slot {
+        public:
+            Slot(void):
+                sig_id_(0),
+                publish_time_(0),
+                overflow_(nullptr),
+                overflow_size_(0),
+                inline_{}
+            {
+            }
+
+            ~Slot(void)
+            {
+                if (overflow_)
+                    delete[] (char*) overflow_;
+            }
+
+            inline const queue_payload_t* payload(void) const
+            {
+                const queue_payload_t* res((const queue_payload_t*) inline_);
+
+                return (res->payload_size <= inline_size)?res:overflow_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline const signal_id_t sig_id(void) const
+            {
+                return sig_id_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline std::uint64_t publish_time(void) const
+            {
+                return publish_time_;
+            }
+
+            // Not thread safe! Caller must manage locks
+            inline void set_sig_id(const signal_id_t id)
+            {
+                sig_id_ = id;
+            }
+
+            inline void set(const signal_id_t sig_id,
+                            const std::uint64_t publish_time,
+                            const char* payload,
+                            const size_t payload_size)
+            {
+                queue_payload_t* dst((queue_payload_t*) inline_);
+
+                // The inline payload size tells payload() where the
+                // payload is, so set it even when the payload goes on
+                // the heap.
+                //
+                dst->payload_size = payload_size;
+
+                if (payload_size > inline_size) {
+                    // Keep the heap payload around for the next
+                    // large payload written to this slot.
+                    if (payload_size > overflow_size_) {
+                        if (overflow_)
+                            delete[] (char*) overflow_;
+
+                        overflow_ = (queue_payload_t*) new char[sizeof(queue_payload_t) + payload_size];
+                        overflow_size_ = payload_size;
+                    }
+                    dst = overflow_;
+                    dst->payload_size = payload_size;
+                }
+
+                memcpy(dst->payload, payload, payload_size);
+                sig_id_ = sig_id;
+                publish_time_ = publish_time;
+            }
+
+        private:
+            signal_id_t sig_id_;
+            std::uint64_t publish_time_;
+            queue_payload_t* overflow_;  // Heap payload, if ever needed.
+            std::uint32_t overflow_size_; // Allocated size of overflow_
+            char inline_[sizeof(queue_payload_t) + inline_size]; // queue_payload_t and payload.
+        };
+
+        static_assert(sizeof(Slot) == cache_line_size, "InlineStorage::Slot must fill one cache line");
+
+        // slot_size is not used by this policy.
+        InlineStorage(const std::uint32_t length,
+                      const std::uint32_t slot_size,
+                      const QueueMemory::Options& memory):
+            length_(length),
+            memory_(sizeof(Slot) * length, memory),
+            slots_((Slot*) memory_.data())
+        {
+            for(std::uint32_t ind = 0; ind < length; ++ind)
+                new (&slots_[ind]) Slot();
+        }
+
+        ~InlineStorage(void)
+        {
+            for(std::uint32_t ind = 0; ind < length_; ++ind)
+                slots_[ind].~Slot();
+        }
+
+        inline Slot& operator[](const std::uint32_t ind) { return slots_[ind]; }
+        inline const Slot& operator[](const std::uint32_t ind) const { return slots_[ind]; }
+        inline std::uint32_t size(void) const { return length_; }
+
+    private:
+        const std::uint32_t length_;
+        QueueMemory memory_; // Page aligned, which keeps the slots cache line aligned.
+        Slot* slots_;
+    };
+}
+#endif // __SIGFS_QUEUE_POLICY__
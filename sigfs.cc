@@ -21,7 +21,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <thread>
 #include "log.h"
 #include "subscriber.hh"
 #include <limits.h>
@@ -29,26 +35,231 @@
 #include <fstream>
 #include "fs.hh"
 #include "queue_impl.hh"
+#include "merge.hh"
 
 using namespace sigfs;
 
 
+// FileHandle
+// Base class of all objects stored in fuse_file_info::fh by do_open(),
+// allowing the other file operations to tell what kind of file
+// was opened.
+//
+class FileHandle {
+public:
+    enum class type_t {
+        signal_file,  // PolledSubscriber
+        virtual_file, // VirtualFileHandle
+        merge_file    // MergeFileHandle
+    };
+
+    FileHandle(const type_t type):
+        type_(type)
+    {
+    }
+
+    virtual ~FileHandle(void)
+    {
+    }
+
+    inline type_t type(void) const
+    {
+        return type_;
+    }
+
+private:
+    const type_t type_;
+};
+
+
+// PollNotifier
+// Sends poll notifications from a dedicated thread, so that the
+// fuse_lowlevel_notify_poll() writes to /dev/fuse are not made by
+// publishers while they hold the queue lock.
+//
+// Poll handles are handed over once per poll() call, so all signals
+// published between the poll() and the notification are coalesced
+// into a single notification.
+//
+class PollNotifier {
+public:
+    PollNotifier(void):
+        stop_(true)
+    {
+    }
+
+    ~PollNotifier(void)
+    {
+        stop();
+    }
+
+    void start(void)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        stop_ = false;
+        thread_ = std::thread([this]() { run_(); });
+    }
+
+    // Stop the thread and destroy the poll handles not yet notified.
+    void stop(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (stop_)
+                return;
+
+            stop_ = true;
+            cond_.notify_all();
+        }
+
+        thread_.join();
+
+        for(auto& iter: pending_)
+            fuse_pollhandle_destroy(iter.second);
+
+        pending_.clear();
+    }
+
+    // Notify, and then destroy, ph at Queue::timestamp() time due,
+    // or as soon as possible if due has passed.
+    //
+    void notify(struct fuse_pollhandle* ph, const std::uint64_t due)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (stop_) {
+            fuse_pollhandle_destroy(ph);
+            return;
+        }
+
+        // Only wake up the thread if ph is due ahead of the handles
+        // it is waiting for.
+        const bool wake(pending_.empty() || due < pending_.begin()->first);
+
+        pending_.emplace(due, ph);
+
+        if (wake)
+            cond_.notify_one();
+    }
+
+private:
+    void run_(void)
+    {
+        std::vector<struct fuse_pollhandle*> ready;
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while(!stop_) {
+            if (pending_.empty()) {
+                cond_.wait(lock);
+                continue;
+            }
+
+            const std::uint64_t now(Queue::timestamp());
+
+            if (pending_.begin()->first > now) {
+                cond_.wait_for(lock, std::chrono::nanoseconds(pending_.begin()->first - now));
+                continue;
+            }
+
+            // Notify all handles due without the lock held, so that
+            // publishers are not held up by fuse.
+            const auto end(pending_.upper_bound(now));
+
+            for(auto iter = pending_.begin(); iter != end; ++iter)
+                ready.push_back(iter->second);
+
+            pending_.erase(pending_.begin(), end);
+            lock.unlock();
+
+            for(auto ph: ready) {
+                fuse_lowlevel_notify_poll(ph);
+                fuse_pollhandle_destroy(ph);
+            }
+
+            ready.clear();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::multimap<std::uint64_t, struct fuse_pollhandle*> pending_; // Keyed on due time
+    bool stop_;
+    std::thread thread_;
+};
+
+PollNotifier g_poll_notifier;
+
+
+// VirtualFileHandle
+// An opened virtual file, such as a .stats file, whose content is
+// rendered once when the file is opened and then read like a
+// regular file.
+//
+// Writing to the file, whatever the data, invokes on_write.
+//
+class VirtualFileHandle: public FileHandle {
+public:
+    VirtualFileHandle(const std::string& content,
+                      std::function<void(void)> on_write = nullptr):
+        FileHandle(FileHandle::type_t::virtual_file),
+        content_(content),
+        on_write_(on_write)
+    {
+    }
+
+    inline const std::string& content(void) const
+    {
+        return content_;
+    }
+
+    inline bool is_writable(void) const
+    {
+        return on_write_ != nullptr;
+    }
+
+    inline void write(void) const
+    {
+        on_write_();
+    }
+
+private:
+    const std::string content_;
+    const std::function<void(void)> on_write_;
+};
+
+
 // PolledSubscriber
 // A standard subscriber with support for struct fuse_pollhandle
 // and poll events, used by the fuse poll subsystem.
 //
-class PolledSubscriber: public Subscriber {
+class PolledSubscriber: public Subscriber, public FileHandle {
 public:
-    PolledSubscriber(std::shared_ptr<Queue> queue):
-        Subscriber(queue),
+    PolledSubscriber(std::shared_ptr<Queue> queue,
+                     const bool is_reader,
+                     const uint32_t read_options,
+                     const cpu_set_t* worker_cpus,
+                     const bool nonblock,
+                     const std::uint64_t poll_interval):
+        Subscriber(queue, is_reader),
+        FileHandle(FileHandle::type_t::signal_file),
         poll_handle_(nullptr),
-        poll_events_(0x00000000)
+        poll_interval_(poll_interval),
+        last_poll_notify_(0),
+        poll_events_(0x00000000),
+        read_options_(read_options),
+        worker_cpus_(worker_cpus),
+        nonblock_(nonblock)
     {
     }
 
     ~PolledSubscriber(void)
     {
         queue()->unsubscribe_read_ready_notifications(this);
+        queue()->unsubscribe_write_ready_notifications(this);
+        poll_handle(nullptr);
     }
 
 
@@ -56,30 +267,39 @@ public:
     // data for others to retreive with dequeue()
     //
     virtual void queue_read_ready(void) {
-        if (!poll_handle_) {
-            SIGFS_LOG_DEBUG("queue_read_ready(): Called - No poll handle. No action")
-            return;
-        }
-        SIGFS_LOG_DEBUG("queue_read_ready(): Called - Poll handle");
-        fuse_lowlevel_notify_poll(poll_handle_);
-        fuse_pollhandle_destroy(poll_handle_);
-        poll_handle_ = 0;
-        return;
+        SIGFS_LOG_DEBUG("queue_read_ready(): Called");
+        notify_poll();
     };
 
-    inline struct fuse_pollhandle* poll_handle(void) const
+    // Called by Queue when subscribers have read signals and freed
+    // up space for us to write to a full queue.
+    //
+    virtual void queue_write_ready(void) {
+        SIGFS_LOG_DEBUG("queue_write_ready(): Called");
+        notify_poll();
+    };
+
+    // Notify the poll handle, if one is installed, at due on the
+    // Queue::timestamp() clock. Used for signals held back by the
+    // minimum interval of the rate limit.
+    //
+    inline void notify_poll_at(const std::uint64_t due)
     {
-        return poll_handle_;
+        notify_poll(due);
     }
 
-
-    inline struct fuse_pollhandle* poll_handle(struct fuse_pollhandle* ph)
+    // Install the poll handle to notify once the events selected
+    // by poll_events() may be ready. Replaces any previous handle.
+    //
+    inline void poll_handle(struct fuse_pollhandle* ph)
     {
+        std::lock_guard<std::mutex> lock(poll_mutex_);
+
         // Delete old poll handle
         if (poll_handle_)
             fuse_pollhandle_destroy(poll_handle_);
 
-        return poll_handle_ = ph;
+        poll_handle_ = ph;
     }
 
     inline uint32_t poll_events(void) const { return poll_events_;  }
@@ -94,21 +314,159 @@ public:
         if (!(pe & POLLIN) && (poll_events_ & POLLIN))
             queue()->unsubscribe_read_ready_notifications(this);
 
+        // Same for write notifications, sent when readers have
+        // made room in a full queue.
+        if ((pe & POLLOUT) && !(poll_events_ & POLLOUT))
+            queue()->subscribe_write_ready_notifications(this);
+
+        if (!(pe & POLLOUT) && (poll_events_ & POLLOUT))
+            queue()->unsubscribe_write_ready_notifications(this);
+
         poll_events_ = pe;
 
         return poll_events_;
 
     }
 
+    // SIGFS_READ_OPT_* bitmask controlling the signal header
+    // format returned by do_read().
+    inline uint32_t read_options(void) const { return read_options_; }
+    inline void read_options(const uint32_t read_options) { read_options_ = read_options; }
+
+    // The file's worker_cpus, or nullptr.
+    inline const cpu_set_t* worker_cpus(void) const { return worker_cpus_; }
+
+    // Opened with O_NONBLOCK. Writes to a full queue fail at once
+    // instead of waiting for overflow_timeout_msec.
+    inline bool nonblock(void) const { return nonblock_; }
+
 private:
+    // Hand the poll handle, if one is installed, over to
+    // g_poll_notifier. Called by readers and writers of the queue
+    // alike.
+    //
+    // Notifications are delayed until due, or until poll_interval_
+    // nanoseconds after the previous one.
+    //
+    void notify_poll(std::uint64_t due = 0)
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex_);
+
+        if (!poll_handle_) {
+            SIGFS_LOG_DEBUG("notify_poll(): No poll handle. No action");
+            return;
+        }
+
+        if (poll_interval_) {
+            due = std::max({ due, Queue::timestamp(), last_poll_notify_ + poll_interval_ });
+            last_poll_notify_ = due;
+        }
+
+        SIGFS_TRACE2(poll_notify, queue()->id(), sub_id());
+        g_poll_notifier.notify(poll_handle_, due);
+        poll_handle_ = nullptr;
+    }
+
+    std::mutex poll_mutex_;
     struct fuse_pollhandle* poll_handle_;
+    const std::uint64_t poll_interval_; // Nanoseconds
+    std::uint64_t last_poll_notify_;    // Protected by poll_mutex_
     uint32_t poll_events_;
+    std::atomic<uint32_t> read_options_;
+    const cpu_set_t* worker_cpus_; // Owned by the FileSystem::File
+    const bool nonblock_;
+};
+
+
+// MergeFileHandle
+// An opened merge file, reading the signal files of a directory
+// tree through a MergedSubscriber, with support for poll.
+//
+class MergeFileHandle: public FileHandle {
+public:
+    MergeFileHandle(const std::vector<MergedSubscriber::Source>& sources):
+        FileHandle(FileHandle::type_t::merge_file),
+        poll_handle_(nullptr),
+        merged_(sources, [this]() { notify_poll(); })
+    {
+    }
+
+    ~MergeFileHandle(void)
+    {
+        poll_handle(nullptr);
+    }
+
+    inline MergedSubscriber& merged(void)
+    {
+        return merged_;
+    }
+
+    // Install the poll handle to notify once a signal is
+    // published to any of the files.
+    inline void poll_handle(struct fuse_pollhandle* ph)
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex_);
+
+        if (poll_handle_)
+            fuse_pollhandle_destroy(poll_handle_);
+
+        poll_handle_ = ph;
+    }
+
+private:
+    // Called by merged_ once a signal is published to a file.
+    void notify_poll(void)
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex_);
+
+        if (!poll_handle_)
+            return;
+
+        g_poll_notifier.notify(poll_handle_, 0);
+        poll_handle_ = nullptr;
+    }
+
+    std::mutex poll_mutex_;
+    struct fuse_pollhandle* poll_handle_;
+
+    // Declared last, so that it stops calling notify_poll() before
+    // the poll handle is destroyed.
+    MergedSubscriber merged_;
 };
 
 
 // Globals for the win
 std::shared_ptr<FileSystem> g_fsys;
 
+// CPUs that sigfs was started on. Worker threads return to these
+// when serving files without worker_cpus.
+cpu_set_t g_default_cpus;
+
+
+// Pin the calling FUSE worker thread to the worker_cpus of the file
+// it is about to serve, or to g_default_cpus if the file has none.
+//
+// The thread keeps running on the file's CPUs after the request is
+// done, so the kernel is only called when the thread moves between
+// files with different CPU sets.
+//
+static void pin_worker(const cpu_set_t* cpus)
+{
+    static thread_local const cpu_set_t* current_cpus = &g_default_cpus;
+
+    if (!cpus)
+        cpus = &g_default_cpus;
+
+    if (cpus == current_cpus)
+        return;
+
+    int res(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), cpus));
+    if (res)
+        SIGFS_LOG_WARNING("pin_worker(): pthread_setaffinity_np(): %s", strerror(res));
+
+    current_cpus = cpus;
+}
+
 
 static int check_fuse_call(int fuse_result, const char* fmt, ...)
 {
@@ -219,6 +577,7 @@ static void do_init(void* userdata, struct fuse_conn_info* conn)
     (void) conn;
 
     SIGFS_LOG_DEBUG("do_init(): Called");
+    g_poll_notifier.start();
 
     return;
 }
@@ -228,6 +587,7 @@ static void do_destroy(void* userdata)
 {
     (void) userdata;
     SIGFS_LOG_DEBUG("do_destroy(): Called");
+    g_poll_notifier.stop();
 }
 
 void setup_stat(std::shared_ptr<FileSystem::INode> entry, uid_t uid, gid_t gid, struct stat* attr)
@@ -423,6 +783,72 @@ static void do_readdir(fuse_req_t req, fuse_ino_t dir_inode, size_t size,
 
 
 
+static void do_open_stats(fuse_req_t req,
+                          std::shared_ptr<FileSystem::INode> stats_entry,
+                          struct fuse_file_info *fi)
+{
+    const struct fuse_ctx* ctx = fuse_req_ctx(req);
+    bool can_read(false);
+    bool can_write(false);
+
+    stats_entry->get_access(ctx->uid, ctx->gid, can_read, can_write);
+
+    const int acc_mode(fi->flags & O_ACCMODE);
+
+    if ((acc_mode != O_WRONLY && !can_read) ||
+        (acc_mode != O_RDONLY && !can_write)) {
+        SIGFS_LOG_DEBUG( "do_open_stats(file_inode: %lu): %s: Access denied" , stats_entry->inode(), stats_entry->name().c_str());
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+
+    auto stats_file(std::dynamic_pointer_cast<FileSystem::StatsFile>(stats_entry));
+
+    // Snapshot the statistics so that consecutive reads at increasing
+    // offsets return a consistent document.
+    //
+    // Any write to the file resets the latency histogram.
+    //
+    auto handle(new VirtualFileHandle((acc_mode != O_WRONLY)?stats_file->content():"",
+                                      (acc_mode != O_RDONLY)?
+                                      std::function<void(void)>([stats_file]() { stats_file->reset(); }):
+                                      nullptr));
+    fi->fh = (uint64_t) static_cast<FileHandle*>(handle);
+    fi->direct_io = 1;
+    check_fuse_call(fuse_reply_open(req, fi),
+                    "do_open_stats(): fuse_reply_open(): Returned: ");
+}
+
+static void do_open_merge(fuse_req_t req,
+                          std::shared_ptr<FileSystem::INode> merge_entry,
+                          struct fuse_file_info *fi)
+{
+    const struct fuse_ctx* ctx = fuse_req_ctx(req);
+    bool can_read(false);
+    bool can_write(false);
+
+    merge_entry->get_access(ctx->uid, ctx->gid, can_read, can_write);
+
+    if ((fi->flags & O_ACCMODE) != O_RDONLY || !can_read) {
+        SIGFS_LOG_DEBUG( "do_open_merge(file_inode: %lu): %s: Access denied" , merge_entry->inode(), merge_entry->name().c_str());
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+
+    auto merge_file(std::dynamic_pointer_cast<FileSystem::MergeFile>(merge_entry));
+    std::vector<MergedSubscriber::Source> sources;
+
+    for(auto& file: merge_file->files())
+        sources.push_back({ file->queue(), file->inode() });
+
+    auto handle(new MergeFileHandle(sources));
+    fi->fh = (uint64_t) static_cast<FileHandle*>(handle);
+    fi->direct_io = 1;
+    fi->nonseekable = 1;
+    check_fuse_call(fuse_reply_open(req, fi),
+                    "do_open_merge(): fuse_reply_open(): Returned: ");
+}
+
 static void do_open(fuse_req_t req, fuse_ino_t file_inode, struct fuse_file_info *fi)
 {
     SIGFS_LOG_DEBUG("do_open(file_inode: %lu | fi=%p): Called", file_inode, fi);
@@ -430,6 +856,22 @@ static void do_open(fuse_req_t req, fuse_ino_t file_inode, struct fuse_file_info
     // g_fsys->lookup_inode() will termiante program if inode not found.
     auto file_entry = g_fsys->lookup_inode(file_inode);
 
+    //
+    // Statistics files are rendered when opened and are read only.
+    //
+    if (FileSystem::StatsFile::is_stats_file(file_entry)) {
+        do_open_stats(req, file_entry, fi);
+        return;
+    }
+
+    //
+    // Merge files read all signal files below their directory.
+    //
+    if (FileSystem::MergeFile::is_merge_file(file_entry)) {
+        do_open_merge(req, file_entry, fi);
+        return;
+    }
+
     //
     // Check that we are trying to open a file, and nothing else.
     //
@@ -481,8 +923,19 @@ static void do_open(fuse_req_t req, fuse_ino_t file_inode, struct fuse_file_info
     // dynamic_pointer_cast<>() will always work since we verified that the entry is a file at the
     // beginning of this function.
     //
-    PolledSubscriber* sub(new PolledSubscriber(std::dynamic_pointer_cast<FileSystem::File>(file_entry)->queue()));
-    fi->fh = (uint64_t) sub;
+    auto file(std::dynamic_pointer_cast<FileSystem::File>(file_entry));
+
+    // Move to the file's CPUs before the queue is created by the
+    // first open, so that its memory is allocated on their node.
+    pin_worker(file->worker_cpus());
+
+    PolledSubscriber* sub(new PolledSubscriber(file->queue(),
+                                               (fi->flags & O_ACCMODE) == O_RDONLY,
+                                               file->read_options(),
+                                               file->worker_cpus(),
+                                               (fi->flags & O_NONBLOCK) != 0,
+                                               file->poll_interval()));
+    fi->fh = (uint64_t) static_cast<FileHandle*>(sub);
     fi->direct_io=1;
     fi->nonseekable=1;
     check_fuse_call(fuse_reply_open(req, fi),
@@ -495,8 +948,8 @@ static void do_open(fuse_req_t req, fuse_ino_t file_inode, struct fuse_file_info
 
 static void do_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
 {
-    PolledSubscriber* sub((PolledSubscriber*) fi->fh);
-    delete sub;
+    FileHandle* handle((FileHandle*) fi->fh);
+    delete handle;
 }
 
 static void read_interrupt(fuse_req_t req, void *data)
@@ -507,104 +960,202 @@ static void read_interrupt(fuse_req_t req, void *data)
 }
 
 
+// Write the header of signal to dst, in the format selected by
+// read_options. See sigfs_common.h for the format.
+//
+static inline void write_signal_header(char* dst,
+                                       const uint32_t read_options,
+                                       const signal_count_t lost_signals,
+                                       const Queue::SignalRef& signal)
+{
+    memcpy(dst, &lost_signals, sizeof(lost_signals));
+    dst += sizeof(lost_signals);
+    memcpy(dst, &signal.signal_id, sizeof(signal.signal_id));
+    dst += sizeof(signal.signal_id);
+
+    if (read_options & SIGFS_READ_OPT_TIMESTAMP) {
+        memcpy(dst, &signal.publish_time, sizeof(signal.publish_time));
+        dst += sizeof(signal.publish_time);
+    }
+
+    if (read_options & SIGFS_READ_OPT_SKIPPED) {
+        memcpy(dst, &signal.signals_skipped, sizeof(signal.signals_skipped));
+        dst += sizeof(signal.signals_skipped);
+    }
+
+    memcpy(dst, &signal.payload_size, sizeof(signal.payload_size));
+}
+
+static void read_merge_interrupt(fuse_req_t req, void *data)
+{
+    MergeFileHandle* handle{(MergeFileHandle*) data};
+    SIGFS_LOG_DEBUG("read_merge_interrupt(): Called");
+    handle->merged().interrupt_dequeue();
+}
+
+// Read signals from all files of a merge file, in publish time order,
+// as sigfs_merged_signal_t records.
+//
+static void do_read_merge(fuse_req_t req, fuse_ino_t file_inode, size_t size, MergeFileHandle* handle)
+{
+    MergedSubscriber& merged(handle->merged());
+    std::vector<char> reply;
+    std::vector<std::pair<std::size_t, std::uint64_t>> delivered; // Source, publish time
+
+    reply.reserve(size);
+
+    auto cb =
+        [size, &merged, &reply, &delivered]
+        (std::size_t source,
+         signal_id_t signal_id,
+         const char* payload,
+         std::uint32_t payload_size,
+         signal_count_t lost_signals,
+         std::uint64_t publish_time) -> Queue::cb_result_t {
+
+            if (size - reply.size() < sizeof(sigfs_merged_signal_t) + payload_size) {
+                SIGFS_LOG_DEBUG("do_read_merge(): size_lft[%ld] < signal_size[%lu]. Return!",
+                                size - reply.size(), sizeof(sigfs_merged_signal_t) + payload_size);
+                return Queue::cb_result_t::not_processed;
+            }
+
+            sigfs_merged_signal_t header;
+
+            header.lost_signals = lost_signals;
+            header.signal_id = signal_id;
+            header.source_inode = merged.source_id(source);
+            header.publish_time = publish_time;
+            header.payload.payload_size = payload_size;
+
+            const std::size_t offset(reply.size());
+
+            reply.resize(offset + sizeof(header) + payload_size);
+            memcpy(reply.data() + offset, &header, sizeof(header));
+            memcpy(reply.data() + offset + sizeof(header), payload, payload_size);
+            delivered.emplace_back(source, publish_time);
+            return Queue::cb_result_t::processed_call_again;
+        };
+
+    fuse_req_interrupt_func(req, read_merge_interrupt, (void*) handle);
+
+    if (!merged.dequeue_signals(cb)) {
+        fuse_req_interrupt_func(req, 0, 0);
+        check_fuse_call(fuse_reply_err(req, EINTR),
+                        "do_read_merge(): Interrupt: fuse_reply_err(req, EINTR) returned: ");
+        return;
+    }
+    fuse_req_interrupt_func(req, 0, 0);
+
+    check_fuse_call(fuse_reply_buf(req, reply.data(), reply.size()),
+                    "do_read_merge(): fuse_reply_buf(%lu) returned ", reply.size());
+    SIGFS_TRACE4(read_reply, file_inode, 0, 0, reply.size());
+
+    const std::uint64_t delivery_time(Queue::timestamp());
+
+    for(auto& signal: delivered)
+        merged.queue(signal.first)->delivery_latency().record(delivery_time - signal.second);
+}
+
 static void do_read(fuse_req_t req, fuse_ino_t file_inode, size_t size,
                     off_t offset, struct fuse_file_info *fi)
 {
 
-    // It works. Stop whining.
-    PolledSubscriber* sub{(PolledSubscriber*) fi->fh};
+    FileHandle* handle{(FileHandle*) fi->fh};
 
     SIGFS_LOG_DEBUG("do_read(%lu): Called. Size[%lu]. offset[%ld]", file_inode, size, offset);
 
+    if (handle->type() == FileHandle::type_t::virtual_file) {
+        const std::string& content(static_cast<VirtualFileHandle*>(handle)->content());
+
+        check_fuse_call(reply_buf_limited(req, content.data(), content.size(), offset, size),
+                        "do_read(): reply_buf_limited() returned: ");
+        return;
+    }
+
+    if (handle->type() == FileHandle::type_t::merge_file) {
+        do_read_merge(req, file_inode, size, static_cast<MergeFileHandle*>(handle));
+        return;
+    }
 
+    PolledSubscriber* sub{static_cast<PolledSubscriber*>(handle)};
+
+    pin_worker(sub->worker_cpus());
 
     // if (offset != 0) {
     //     SIGFS_LOG_FATAL("do_read(): Offset %lu not implemented.", offset);
     //     exit(1);
     // }
 
-    // We either deliver 100 signals in one go, or as many
-    // as we can until size_left runs out.
+    // Deliver up to 20 signals in one go, or as many as fit in
+    // size.
+    //
+    // The signals are copied into reply while the queue is locked
+    // by dequeue_signals(). Publishers may overwrite their slots
+    // as soon as it returns, before fuse_reply_buf() is done with
+    // them. reply is kept by each worker thread to avoid an
+    // allocation per read.
     //
-    struct iovec iov[40]; // 56 Seems to be the max that fuse_reply_iov() accepts.
-//    sigfs_signal_t sig[IOV_MAX/2+1];
-    sigfs_signal_t sig[20];
+    static thread_local std::vector<char> reply;
+    std::uint64_t sig_publish_time[20];
     std::uint32_t sig_ind = 0;
-    std::uint32_t iov_ind = 0;
-    size_t size_left = size; // Number of bytes left that we can report
-    std::uint32_t tot_payload = 0;
+    size_t tot_payload = 0; // Number of bytes in reply
+    const std::uint32_t read_options(sub->read_options());
+    const std::uint32_t header_size(sigfs_signal_header_size(read_options));
 
-    Queue::signal_callback_t<fuse_req_t> cb =
-        [sub, &iov, &sig, &sig_ind, &iov_ind, &size_left, &tot_payload]
-        (fuse_req_t req,
-         signal_id_t signal_id,
-         const char* payload,
-         std::uint32_t payload_size,
-         signal_count_t lost_signals,
-         signal_count_t remaining_signal_count) -> Queue::cb_result_t {
+    if (reply.size() < size)
+        reply.resize(size);
+
+    // Build the reply from a single batch of ready signals.
+    //
+    auto cb =
+        [req, sub, size, &sig_publish_time, &sig_ind, &tot_payload,
+         read_options, header_size]
+        (const Queue::SignalBatch& batch) -> std::size_t {
 
             //
             // Is this an interrupt call?
             //
-            if (!payload) {
+            if (batch.empty()) {
                 SIGFS_LOG_DEBUG("do_read(): Interrupted!");
                 fuse_req_interrupt_func(req, 0, 0);
 
                 sub->set_interrupted(false);
-                return Queue::cb_result_t::not_processed;
+                return 0;
             }
 
-            // Do we have enough space left for payload?
-            if (size_left < sizeof(sigfs_signal_t) + payload_size) {
-                SIGFS_LOG_DEBUG("do_read(): size_lft[%ld] < signal_size[%lu]. Return!",
-                                size_left, sizeof(sigfs_signal_t) + payload_size);
-                return Queue::cb_result_t::not_processed;
-            }
+            for(const Queue::SignalRef& signal: batch) {
+                // Lost signals are reported in the first signal header only.
+                const signal_count_t lost_signals(sig_ind?0:batch.lost_signals());
 
-            sig[sig_ind] = {
-                .lost_signals = lost_signals,
-                .signal_id = signal_id,
-                .payload = {
-                    .payload_size = payload_size,
+                // Do we have enough space left for payload?
+                if (size - tot_payload < header_size + signal.payload_size) {
+                    SIGFS_LOG_DEBUG("do_read(): size_lft[%ld] < signal_size[%lu]. Return!",
+                                    size - tot_payload, header_size + signal.payload_size);
+                    break;
                 }
-            };
-
-            iov[iov_ind] = {
-                .iov_base=(void*) &sig[sig_ind],
-                .iov_len=sizeof(sigfs_signal_t)
-            };
-
-            SIGFS_LOG_DEBUG("do_read(): Adding iov_ind[%d] signal_id[%lu/%lu] payload_size[%u/%u/%u]",
-                            iov_ind,
-                            signal_id, 
-                            sig[sig_ind].signal_id,
-                            payload_size,
-                            sig[sig_ind].payload.payload_size,
-                            ((sigfs_signal_t*) iov[iov_ind].iov_base)->payload.payload_size);
-
-            iov_ind++;
-
-            iov[iov_ind] = {
-                .iov_base=(void*) payload,
-                .iov_len=payload_size
-            };
-            iov_ind++;
-            sig_ind++;
-            tot_payload += sizeof(sigfs_signal_t) + payload_size;
 
-            //
-            // Can we accept more callbacks?
-            //
-            if (iov_ind < sizeof(iov)/sizeof(iov[0]) - 1 && remaining_signal_count > 0)
-                return Queue::cb_result_t::processed_call_again;
+                SIGFS_LOG_DEBUG("do_read(): Adding signal_id[%lu] payload_size[%u] header_size[%u]",
+                                signal.signal_id,
+                                signal.payload_size,
+                                header_size);
 
-            return Queue::cb_result_t::processed_dont_call_again;
+                char* dst(reply.data() + tot_payload);
+
+                write_signal_header(dst, read_options, lost_signals, signal);
+                memcpy(dst + header_size, signal.payload, signal.payload_size);
+
+                sig_publish_time[sig_ind] = signal.publish_time;
+                sig_ind++;
+                tot_payload += header_size + signal.payload_size;
+            }
+
+            return sig_ind;
         };
 
     fuse_req_interrupt_func(req, read_interrupt, (void*) sub);
 
     // If we are interrupted, don't send back anything
-    if (!sub->queue()->dequeue_signal<fuse_req_t>(*sub, req, cb)) {
+    if (!sub->queue()->dequeue_signals(*sub, sizeof(sig_publish_time)/sizeof(sig_publish_time[0]), cb)) {
         // Only nil the interrupt function if we were not interrupted.
         // If we were interrupted, this will be done by the lambda
         // function above.
@@ -618,12 +1169,23 @@ static void do_read(fuse_req_t req, fuse_ino_t file_inode, size_t size,
     // Nil out the interrupt function.
     fuse_req_interrupt_func(req, 0, 0);
 
-    SIGFS_LOG_DEBUG("do_read(): Sending back %d (of max %d) iov entries. Total length: %lu",
-                    iov_ind, IOV_MAX, tot_payload);
+    SIGFS_LOG_DEBUG("do_read(): Sending back %u signals. Total length: %lu",
+                    sig_ind, tot_payload);
+
+    check_fuse_call(fuse_reply_buf(req, reply.data(), tot_payload),
+                    "do_read(): fuse_reply_buf(%lu) returned ",
+                    tot_payload);
+    SIGFS_TRACE4(read_reply, file_inode, sub->sig_id(), sub->sub_id(), tot_payload);
+
+    // The signals have now been handed over to the subscribing
+    // process. Record their publish-to-delivery latency.
+    //
+    const std::uint64_t delivery_time(Queue::timestamp());
+    Histogram& latency(sub->queue()->delivery_latency());
+
+    for(std::uint32_t ind = 0; ind < sig_ind; ++ind)
+        latency.record(delivery_time - sig_publish_time[ind]);
 
-    check_fuse_call(fuse_reply_iov(req, iov, iov_ind),
-                    "do_read(): fuse_reply_iov(%d) returned ",
-                    iov_ind);
     return;
 }
 
@@ -631,7 +1193,33 @@ static void do_read(fuse_req_t req, fuse_ino_t file_inode, size_t size,
 static void do_write(fuse_req_t req, fuse_ino_t ino, const char *buffer,
                      size_t size, off_t offset, struct fuse_file_info *fi)
 {
-    PolledSubscriber* sub((PolledSubscriber*) fi->fh);
+    FileHandle* handle((FileHandle*) fi->fh);
+
+    if (handle->type() == FileHandle::type_t::virtual_file) {
+        VirtualFileHandle* vfile(static_cast<VirtualFileHandle*>(handle));
+
+        if (!vfile->is_writable()) {
+            check_fuse_call(fuse_reply_err(req, EBADF),
+                            "do_write(%lu): fuse_reply_err(EBADF) returned: ", ino);
+            return;
+        }
+
+        vfile->write();
+        check_fuse_call(fuse_reply_write(req, size),
+                        "do_write(%lu): fuse_reply_write(%lu) returned: ", ino, size);
+        return;
+    }
+
+    // Merge files are opened read only.
+    if (handle->type() == FileHandle::type_t::merge_file) {
+        check_fuse_call(fuse_reply_err(req, EBADF),
+                        "do_write(%lu): fuse_reply_err(EBADF) returned: ", ino);
+        return;
+    }
+
+    PolledSubscriber* sub(static_cast<PolledSubscriber*>(handle));
+
+    pin_worker(sub->worker_cpus());
 
     SIGFS_LOG_DEBUG("do_write(%lu/%p): Called, offset[%lu] size[%lu]", ino, fi, offset, size);
     print_poll_info("do_write(): ", sub->poll_events());
@@ -674,8 +1262,25 @@ static void do_write(fuse_req_t req, fuse_ino_t ino, const char *buffer,
 
         //
         // Queue signal.
+        // A full queue with "overflow" set to "block" or "eagain"
+        // rejects the signal. Report the signals queued so far as
+        // written, or EAGAIN if there are none.
         //
-        sub->queue()->queue_signal(payload->payload, payload->payload_size);
+        if (!sub->queue()->queue_signal(payload->payload, payload->payload_size, sub->nonblock())) {
+            SIGFS_LOG_DEBUG("do_write(%lu): Queue full after %lu bytes", ino, size - remaining_bytes);
+
+            if (remaining_bytes == size) {
+                check_fuse_call(fuse_reply_err(req, EAGAIN),
+                                "do_write(%lu): fuse_reply_err(EAGAIN) returned: ", ino);
+                return;
+            }
+
+            check_fuse_call(fuse_reply_write(req, size - remaining_bytes),
+                            "do_write(%lu): fuse_reply_write(%lu) returned: ",
+                            ino, size - remaining_bytes);
+            return;
+        }
+
         SIGFS_LOG_DEBUG("do_write(%lu): Queued %d payload bytes", ino,payload->payload_size);
         remaining_bytes -= SIGFS_PAYLOAD_SIZE(payload);
         buffer += SIGFS_PAYLOAD_SIZE(payload);
@@ -699,11 +1304,46 @@ void  do_poll(fuse_req_t req,
               struct fuse_file_info *fi,
               struct fuse_pollhandle *ph)
 {
-    // It works. Stop whining.
-    PolledSubscriber* sub{(PolledSubscriber*) fi->fh};
+    FileHandle* handle{(FileHandle*) fi->fh};
 
     SIGFS_LOG_DEBUG("do_poll(%lu/%p): Called", ino, fi);
 
+    // Virtual files always have their content ready.
+    if (handle->type() == FileHandle::type_t::virtual_file) {
+        check_fuse_call(fuse_reply_poll(req, fi->poll_events & POLLIN),
+                        "do_poll(%lu): fuse_reply_poll() returned: ", ino);
+        if (ph)
+            fuse_pollhandle_destroy(ph);
+        return;
+    }
+
+    if (handle->type() == FileHandle::type_t::merge_file) {
+        MergeFileHandle* merge{static_cast<MergeFileHandle*>(handle)};
+
+        // Arm the poll handle before checking, so that a signal
+        // published in between is not missed.
+        if (fi->poll_events & POLLIN)
+            merge->poll_handle(ph);
+        else if (ph)
+            fuse_pollhandle_destroy(ph);
+
+        check_fuse_call(fuse_reply_poll(req,
+                                        ((fi->poll_events & POLLIN) &&
+                                         merge->merged().signal_available())?POLLIN:0),
+                        "do_poll(%lu): fuse_reply_poll() [merge] returned: ", ino);
+        return;
+    }
+
+    PolledSubscriber* sub{static_cast<PolledSubscriber*>(handle)};
+
+    // Rembember the poll handle, and have poll_events() setup the
+    // necessary subscriptions, before checking for events. A signal
+    // published, or read, in between will then notify the handle
+    // instead of being missed.
+    //
+    sub->poll_handle(ph);
+    sub->poll_events(fi->poll_events);
+
     // Check if we are polling for POLLIN and have
     // elements available for reading.
     //
@@ -711,26 +1351,36 @@ void  do_poll(fuse_req_t req,
     if ((fi->poll_events & POLLIN) && sub->signal_available() > 0)
         immediate_events |= POLLIN;
 
+    // Check if we are polling for POLLOUT and can write without
+    // blocking. Always the case unless the file's "overflow" is
+    // "block" or "eagain".
+    //
+    if ((fi->poll_events & POLLOUT) && sub->queue()->write_space_available())
+        immediate_events |= POLLOUT;
 
     // Do we have either poll in or poll out?
     if (immediate_events) {
         SIGFS_LOG_DEBUG("do_poll(%lu/%p): Immediate event is available", ino, fi);
-        check_fuse_call(fuse_reply_poll(req, immediate_events),
-                        "do_poll(%lu): fuse_reply_poll(POLLIN) returned: ", ino);
-
-        if (ph)
-            fuse_pollhandle_destroy(ph);
 
+        // Not needed.
+        sub->poll_handle(nullptr);
+        check_fuse_call(fuse_reply_poll(req, immediate_events),
+                        "do_poll(%lu): fuse_reply_poll(%.8X) returned: ", ino, immediate_events);
         return;
     }
 
-    // Rembember the poll handle.
-    // It is undocumented if we can destroy this poll handle if there
-    // is already data available
-    sub->poll_handle(ph);
+    // A signal held back by the minimum interval of the rate limit
+    // is not announced by a publisher. Notify once the interval is
+    // up instead.
+    //
+    if (fi->poll_events & POLLIN) {
+        const std::uint64_t held_until(sub->queue()->signal_held_until(*sub));
 
-    // poll_events() will setup the necessary subscription.
-    sub->poll_events(fi->poll_events);
+        if (held_until)
+            sub->notify_poll_at(held_until);
+    }
+
+    SIGFS_TRACE2(poll_arm, ino, sub->sub_id());
 
     SIGFS_LOG_DEBUG("do_poll(%lu/%p): No immediate event is available", ino, fi);
     check_fuse_call(fuse_reply_poll(req, 0x0000),
@@ -738,6 +1388,214 @@ void  do_poll(fuse_req_t req,
     return;
 }
 
+static void do_ioctl(fuse_req_t req,
+                     fuse_ino_t ino,
+                     unsigned int cmd,
+                     void *arg,
+                     struct fuse_file_info *fi,
+                     unsigned flags,
+                     const void *in_buf,
+                     size_t in_bufsz,
+                     size_t out_bufsz)
+{
+    FileHandle* handle{(FileHandle*) fi->fh};
+
+    SIGFS_LOG_DEBUG("do_ioctl(%lu/%p): Called. cmd[%.8X] in_bufsz[%lu] out_bufsz[%lu]",
+                    ino, fi, cmd, in_bufsz, out_bufsz);
+
+    if (handle->type() != FileHandle::type_t::signal_file) {
+        check_fuse_call(fuse_reply_err(req, ENOTTY),
+                        "do_ioctl(%lu): fuse_reply_err(ENOTTY) returned: ", ino);
+        return;
+    }
+
+    PolledSubscriber* sub{static_cast<PolledSubscriber*>(handle)};
+
+    switch(cmd) {
+    case SIGFS_IOC_SET_READ_OPTIONS: {
+        if (in_bufsz != sizeof(uint32_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [1] returned: ", ino);
+            return;
+        }
+
+        uint32_t read_options(*(const uint32_t*) in_buf);
+
+        if (read_options & ~SIGFS_READ_OPT_ALL) {
+            SIGFS_LOG_INFO("do_ioctl(%lu): Unknown read options [%.8X]", ino, read_options);
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [2] returned: ", ino);
+            return;
+        }
+
+        sub->read_options(read_options);
+        check_fuse_call(fuse_reply_ioctl(req, 0, nullptr, 0),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [1] returned: ", ino);
+        return;
+    }
+
+    case SIGFS_IOC_GET_READ_OPTIONS: {
+        if (out_bufsz != sizeof(uint32_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [3] returned: ", ino);
+            return;
+        }
+
+        uint32_t read_options(sub->read_options());
+        check_fuse_call(fuse_reply_ioctl(req, 0, &read_options, sizeof(read_options)),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [2] returned: ", ino);
+        return;
+    }
+
+    case SIGFS_IOC_SET_FILTER: {
+        SignalFilter filter;
+
+        if (in_bufsz != sizeof(sigfs_filter_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [4] returned: ", ino);
+            return;
+        }
+
+        if (!filter.set(*(const sigfs_filter_t*) in_buf)) {
+            SIGFS_LOG_INFO("do_ioctl(%lu): Invalid filter", ino);
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [5] returned: ", ino);
+            return;
+        }
+
+        sub->queue()->set_filter(*sub, filter);
+        check_fuse_call(fuse_reply_ioctl(req, 0, nullptr, 0),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [3] returned: ", ino);
+        return;
+    }
+
+    case SIGFS_IOC_GET_FILTER: {
+        sigfs_filter_t filter;
+
+        if (out_bufsz != sizeof(sigfs_filter_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [6] returned: ", ino);
+            return;
+        }
+
+        sub->filter().get(filter);
+        check_fuse_call(fuse_reply_ioctl(req, 0, &filter, sizeof(filter)),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [4] returned: ", ino);
+        return;
+    }
+
+    case SIGFS_IOC_SET_RATE: {
+        DeliveryRate rate;
+
+        if (in_bufsz != sizeof(sigfs_rate_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [7] returned: ", ino);
+            return;
+        }
+
+        if (!rate.set(*(const sigfs_rate_t*) in_buf)) {
+            SIGFS_LOG_INFO("do_ioctl(%lu): Invalid rate", ino);
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [8] returned: ", ino);
+            return;
+        }
+
+        sub->queue()->set_rate(*sub, rate);
+        check_fuse_call(fuse_reply_ioctl(req, 0, nullptr, 0),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [5] returned: ", ino);
+        return;
+    }
+
+    case SIGFS_IOC_GET_RATE: {
+        sigfs_rate_t rate;
+
+        if (out_bufsz != sizeof(sigfs_rate_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [9] returned: ", ino);
+            return;
+        }
+
+        sub->rate().get(rate);
+        check_fuse_call(fuse_reply_ioctl(req, 0, &rate, sizeof(rate)),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [6] returned: ", ino);
+        return;
+    }
+
+    case SIGFS_IOC_SET_LAG: {
+        LagPolicy lag;
+
+        if (in_bufsz != sizeof(sigfs_lag_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [12] returned: ", ino);
+            return;
+        }
+
+        if (!lag.set(*(const sigfs_lag_t*) in_buf)) {
+            SIGFS_LOG_INFO("do_ioctl(%lu): Invalid lag policy", ino);
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [13] returned: ", ino);
+            return;
+        }
+
+        sub->queue()->set_lag(*sub, lag);
+        check_fuse_call(fuse_reply_ioctl(req, 0, nullptr, 0),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [8] returned: ", ino);
+        return;
+    }
+
+    case SIGFS_IOC_GET_LAG: {
+        sigfs_lag_t lag;
+
+        if (out_bufsz != sizeof(sigfs_lag_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [14] returned: ", ino);
+            return;
+        }
+
+        sub->lag().get(lag);
+        check_fuse_call(fuse_reply_ioctl(req, 0, &lag, sizeof(lag)),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [9] returned: ", ino);
+        return;
+    }
+
+    case SIGFS_IOC_SEEK: {
+        static const Queue::seek_t whences[] = {
+            Queue::seek_t::signal_id, // SIGFS_SEEK_SIGNAL_ID
+            Queue::seek_t::oldest,    // SIGFS_SEEK_OLDEST
+            Queue::seek_t::newest     // SIGFS_SEEK_NEWEST
+        };
+        sigfs_seek_t seek;
+
+        if (in_bufsz != sizeof(sigfs_seek_t) || out_bufsz != sizeof(sigfs_seek_t)) {
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [10] returned: ", ino);
+            return;
+        }
+
+        memcpy(&seek, in_buf, sizeof(seek));
+
+        if (seek.whence >= sizeof(whences) / sizeof(whences[0])) {
+            SIGFS_LOG_INFO("do_ioctl(%lu): Unknown seek whence [%u]", ino, seek.whence);
+            check_fuse_call(fuse_reply_err(req, EINVAL),
+                            "do_ioctl(%lu): fuse_reply_err(EINVAL) [11] returned: ", ino);
+            return;
+        }
+
+        // Signal id 0 is taken as the oldest signal by Queue::seek().
+        seek.value = sub->queue()->seek(*sub, whences[seek.whence], seek.value, seek.lost_signals);
+        check_fuse_call(fuse_reply_ioctl(req, 0, &seek, sizeof(seek)),
+                        "do_ioctl(%lu): fuse_reply_ioctl() [7] returned: ", ino);
+        return;
+    }
+
+    default:
+        SIGFS_LOG_DEBUG("do_ioctl(%lu): Unknown cmd [%.8X]", ino, cmd);
+        check_fuse_call(fuse_reply_err(req, ENOTTY),
+                        "do_ioctl(%lu): fuse_reply_err(ENOTTY) returned: ", ino);
+        return;
+    }
+}
+
 static void dummy_log(fuse_log_level level, const char *fmt, va_list ap)
 {
 #ifndef SIGFS_LOG
@@ -770,6 +1628,7 @@ void usage(const char* name)
 {
     std::cout << "Usage: " << name << " -c <config-file.json> | --config=<config-file.json> <mount-directory>" << std::endl;
     std::cout << "         -c <config-file.json>  The JSON configuration file to load." << std::endl;
+    std::cout << "         --mlockall             Lock all current and future memory in RAM." << std::endl;
 //    std::cout << "        -f <file> | --file=<file>" << std::endl;
 //    std::cout << "        -c <signal-count> | --count=<signal-count>" << std::endl;
 //    std::cout << "        -s <usec> | --sleep=<usec>" << std::endl;
@@ -784,9 +1643,11 @@ void usage(const char* name)
 int main(int argc, char *argv[])
 {
     std::string config_file;
+    bool lock_all_memory = false;
     int ch = 0;
     static struct option long_options[] =  {
         {"config", required_argument, NULL, 'c'},
+        {"mlockall", no_argument, NULL, 'L'}, // Long option only.
         {NULL, 0, NULL, 0}
     };
 
@@ -813,6 +1674,10 @@ int main(int argc, char *argv[])
 //            std::cout << "Accepting ["<<argv[tmpind]<<"]" << std::endl;
             break;
 
+        case 'L':
+            lock_all_memory = true;
+            break;
+
         case '?': {
             if (fuse_argc == fuse_max_argv) {
 //                std::cerr << "Too many arguments. Max number " << fuse_argc-1 << std::endl;
@@ -857,6 +1722,19 @@ int main(int argc, char *argv[])
         exit(1);
     }
     g_fsys = std::make_shared<FileSystem>(json::parse(cfg_stream));
+
+    if (sched_getaffinity(0, sizeof(g_default_cpus), &g_default_cpus)) {
+        std::cerr << "sched_getaffinity(): " << strerror(errno) << std::endl;
+        exit(255);
+    }
+
+    // Lock everything, including queues, FUSE buffers and thread
+    // stacks allocated later on, so that the signal path never
+    // page faults.
+    if (lock_all_memory && mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        std::cerr << "--mlockall: " << strerror(errno) << ". Check RLIMIT_MEMLOCK (ulimit -l)." << std::endl;
+        exit(255);
+    }
     struct fuse_args args = FUSE_ARGS_INIT(fuse_argc, fuse_argv);
     struct fuse_session *se;
     struct fuse_cmdline_opts opts;
@@ -937,6 +1815,7 @@ int main(int argc, char *argv[])
         .write	     = do_write,
         .release     = do_release,
         .readdir     = do_readdir,
+        .ioctl       = do_ioctl,
         .poll        = do_poll,
     };
 
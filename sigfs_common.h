@@ -10,6 +10,7 @@
 #define __SIGFS_COMMON__
 
 #include <stdint.h>
+#include <sys/ioctl.h>
 typedef uint64_t signal_id_t;
 typedef uint32_t signal_count_t;
 
@@ -50,6 +51,222 @@ typedef struct sigfs_signal_t_ {
 
 #define SIGFS_SIGNAL_SIZE(signal) (sizeof(sigfs_signal_t) + signal->payload.payload_size)
 
+//
+// Read options
+//
+// Read options add optional fields to the header of each signal
+// returned by read(). Optional fields are placed between signal_id
+// and payload, in the order of their option bits.
+//
+// Options are set per file in the JSON configuration, and can be
+// changed for a single file descriptor with the
+// SIGFS_IOC_SET_READ_OPTIONS ioctl.
+//
+
+// Add the time, in nanoseconds of CLOCK_MONOTONIC, when the signal
+// was published.
+//
+#define SIGFS_READ_OPT_TIMESTAMP  0x00000001
+
+// Add the number of signals skipped by the rate limit set with
+// SIGFS_IOC_SET_RATE since the previous signal was read. Skipped
+// signals are not included in lost_signals.
+//
+#define SIGFS_READ_OPT_SKIPPED    0x00000002
+
+#define SIGFS_READ_OPT_ALL (SIGFS_READ_OPT_TIMESTAMP | SIGFS_READ_OPT_SKIPPED)
+
+//
+// Single signal as returned when SIGFS_READ_OPT_TIMESTAMP is the
+// only read option set.
+//
+typedef struct sigfs_signal_ts_t_ {
+    signal_count_t lost_signals;
+    signal_id_t signal_id;
+
+    // CLOCK_MONOTONIC time, in nanoseconds, when the signal was written.
+    uint64_t publish_time;
+
+    sigfs_payload_t payload;
+} __attribute__((packed)) sigfs_signal_ts_t;
+
+#define SIGFS_SIGNAL_TS_SIZE(signal) (sizeof(sigfs_signal_ts_t) + signal->payload.payload_size)
+
+// Number of bytes in a signal header, up to and including
+// payload_size, with the given read options set.
+//
+static inline uint32_t sigfs_signal_header_size(uint32_t read_options)
+{
+    return sizeof(sigfs_signal_t) +
+        ((read_options & SIGFS_READ_OPT_TIMESTAMP)?sizeof(uint64_t):0) +
+        ((read_options & SIGFS_READ_OPT_SKIPPED)?sizeof(signal_count_t):0);
+}
+
+// Largest header returned by sigfs_signal_header_size()
+#define SIGFS_SIGNAL_HEADER_MAX_SIZE (sizeof(sigfs_signal_t) + sizeof(uint64_t) + sizeof(signal_count_t))
+
+//
+// Single signal as returned by read() on a directory's merge file,
+// declared with "merge_file" in the directory's configuration.
+//
+// Signals from all signal files below the directory are returned in
+// publish_time order. Read options do not apply to merge files.
+//
+typedef struct sigfs_merged_signal_t_ {
+    // Number of signals lost from the source file since the
+    // previous signal read from it.
+    signal_count_t lost_signals;
+
+    // Id of the signal in the source file.
+    signal_id_t signal_id;
+
+    // Inode of the signal file the signal was published to.
+    uint64_t source_inode;
+
+    // CLOCK_MONOTONIC time, in nanoseconds, when the signal was written.
+    uint64_t publish_time;
+
+    sigfs_payload_t payload;
+} __attribute__((packed)) sigfs_merged_signal_t;
+
+#define SIGFS_MERGED_SIGNAL_SIZE(signal) (sizeof(sigfs_merged_signal_t) + signal->payload.payload_size)
+
+//
+// Payload of the signals published to a derived aggregate file,
+// declared with an "aggregate" object in the file's configuration.
+//
+typedef struct sigfs_aggregate_t_ {
+    // CLOCK_MONOTONIC time, in nanoseconds, when the window started.
+    uint64_t window_start;
+
+    // Number of source signals in the window.
+    uint32_t count;
+
+    // The configured min, max, mean, or sum of the source field.
+    double value;
+} __attribute__((packed)) sigfs_aggregate_t;
+
+//
+// ioctl() commands accepted by signal files.
+//
+#define SIGFS_IOC_MAGIC 0xF5
+
+// Set / retrieve the SIGFS_READ_OPT_* bitmask of a file descriptor.
+// Takes a pointer to an uint32_t.
+//
+#define SIGFS_IOC_SET_READ_OPTIONS _IOW(SIGFS_IOC_MAGIC, 1, uint32_t)
+#define SIGFS_IOC_GET_READ_OPTIONS _IOR(SIGFS_IOC_MAGIC, 2, uint32_t)
+
+//
+// Subscriber filters
+//
+// A filter installed on a file descriptor with SIGFS_IOC_SET_FILTER
+// drops all signals that do not match every predicate of the filter
+// before they are returned by read(). Dropped signals are not
+// reported as lost.
+//
+// A predicate compares <size> (1-8) payload bytes starting at
+// <offset>. Payload byte offset + n is masked with byte n of mask,
+// counting from the least significant byte, and compared with byte
+// n of value. Payloads too short to hold all <size> bytes never
+// match.
+//
+#define SIGFS_FILTER_MAX_PREDICATES 8
+
+typedef struct sigfs_filter_predicate_t_ {
+    uint32_t offset;
+    uint32_t size;
+    uint64_t mask;
+    uint64_t value;
+} sigfs_filter_predicate_t;
+
+typedef struct sigfs_filter_t_ {
+    uint32_t predicate_count; // 0 removes the filter.
+    uint32_t reserved;        // Must be 0.
+    sigfs_filter_predicate_t predicates[SIGFS_FILTER_MAX_PREDICATES];
+} sigfs_filter_t;
+
+// Install / retrieve the filter of a file descriptor.
+// Takes a pointer to a sigfs_filter_t.
+//
+#define SIGFS_IOC_SET_FILTER _IOW(SIGFS_IOC_MAGIC, 3, sigfs_filter_t)
+#define SIGFS_IOC_GET_FILTER _IOR(SIGFS_IOC_MAGIC, 4, sigfs_filter_t)
+
+//
+// Delivery rate limits
+//
+// A rate limit installed on a file descriptor with SIGFS_IOC_SET_RATE
+// skips signals that would otherwise be read, without copying them.
+//
+// decimation - Deliver every <decimation>th signal. After a signal
+//              has been delivered, the following decimation - 1
+//              signals published to the file are skipped. 0 and 1
+//              deliver all signals.
+//
+// min_interval_nsec - Only deliver signals published at least
+//              min_interval_nsec nanoseconds after the previously
+//              delivered signal. Of the signals ready to be read,
+//              only the newest one is delivered.
+//
+// Signals not passing the filter set with SIGFS_IOC_SET_FILTER are
+// never delivered.
+//
+typedef struct sigfs_rate_t_ {
+    uint64_t min_interval_nsec; // 0 disables the interval limit.
+    uint32_t decimation;        // 0 or 1 disables decimation.
+    uint32_t reserved;          // Must be 0.
+} sigfs_rate_t;
+
+// Install / retrieve the rate limit of a file descriptor.
+// Takes a pointer to a sigfs_rate_t.
+//
+#define SIGFS_IOC_SET_RATE _IOW(SIGFS_IOC_MAGIC, 5, sigfs_rate_t)
+#define SIGFS_IOC_GET_RATE _IOR(SIGFS_IOC_MAGIC, 6, sigfs_rate_t)
+
+//
+// Lag policies
+//
+// A file descriptor with a lag policy installed by SIGFS_IOC_SET_LAG
+// that has more than max_lag signals waiting to be read when read()
+// is called skips ahead to the keep newest signals, instead of
+// reading through the backlog. Skipped signals are reported as
+// signals skipped, not as lost.
+//
+typedef struct sigfs_lag_t_ {
+    uint32_t max_lag; // 0 disables the lag policy.
+    uint32_t keep;    // 1 - max_lag.
+} sigfs_lag_t;
+
+// Install / retrieve the lag policy of a file descriptor.
+// Takes a pointer to a sigfs_lag_t.
+//
+#define SIGFS_IOC_SET_LAG _IOW(SIGFS_IOC_MAGIC, 8, sigfs_lag_t)
+#define SIGFS_IOC_GET_LAG _IOR(SIGFS_IOC_MAGIC, 9, sigfs_lag_t)
+
+//
+// Subscriber positioning
+//
+// A file descriptor opened for reading starts with the next signal
+// published to the file. SIGFS_IOC_SEEK moves it back to signals
+// still held by the file's queue, so that a restarted subscriber can
+// pick up where it left off by seeking to the id following the last
+// signal it read.
+//
+#define SIGFS_SEEK_SIGNAL_ID 0 // Read signal <value> next. 0 reads the oldest signal.
+#define SIGFS_SEEK_OLDEST    1 // Read the oldest signal in the queue next.
+#define SIGFS_SEEK_NEWEST    2 // Read the <value> newest signals next.
+
+typedef struct sigfs_seek_t_ {
+    uint32_t whence;             // SIGFS_SEEK_*
+    signal_count_t lost_signals; // Returned: Signals requested but no longer in the queue.
+    uint64_t value;              // See whence. Returned: Id of the next signal to read.
+} sigfs_seek_t;
+
+// Move a file descriptor. Takes a pointer to a sigfs_seek_t, which
+// is updated with the result.
+//
+#define SIGFS_IOC_SEEK _IOWR(SIGFS_IOC_MAGIC, 7, sigfs_seek_t)
+
 #ifdef __cplusplus
 }
 #endif
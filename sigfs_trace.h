@@ -0,0 +1,57 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+//
+// USDT (user statically-defined tracing) probes.
+//
+// If <sys/sdt.h> (systemtap-sdt-dev on Debian/Ubuntu) is available at
+// build time, each SIGFS_TRACE() statement becomes a single nop
+// instruction plus an ELF note describing the probe and its
+// arguments. The probe has no measurable cost until a tracer, such as
+// bpftrace, attaches to it.
+//
+// Define SIGFS_NO_USDT to build without probes.
+//
+// All probes belong to the "sigfs" provider and use the following
+// argument conventions, in this order, for the arguments they carry:
+//
+//   inode   - Inode of the signal file (Queue::id())
+//   sig_id  - Signal ID
+//   sub_id  - Subscriber ID
+//   bytes   - Byte count
+//
+// See trace/ for bpftrace scripts using the probes.
+//
+
+#ifndef __SIGFS_TRACE__
+#define __SIGFS_TRACE__
+
+#if !defined(SIGFS_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define SIGFS_USDT 1
+#endif
+#endif
+
+#ifdef SIGFS_USDT
+#include <sys/sdt.h>
+
+#define SIGFS_TRACE1(name, a1) DTRACE_PROBE1(sigfs, name, a1)
+#define SIGFS_TRACE2(name, a1, a2) DTRACE_PROBE2(sigfs, name, a1, a2)
+#define SIGFS_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(sigfs, name, a1, a2, a3)
+#define SIGFS_TRACE4(name, a1, a2, a3, a4) DTRACE_PROBE4(sigfs, name, a1, a2, a3, a4)
+
+#else
+
+#define SIGFS_TRACE1(name, a1)
+#define SIGFS_TRACE2(name, a1, a2)
+#define SIGFS_TRACE3(name, a1, a2, a3)
+#define SIGFS_TRACE4(name, a1, a2, a3, a4)
+
+#endif
+
+#endif // __SIGFS_TRACE__
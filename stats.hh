@@ -0,0 +1,66 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+#ifndef __SIGFS_STATS__
+#define __SIGFS_STATS__
+#include <atomic>
+#include <cstdint>
+
+namespace sigfs {
+
+    // Statistics counter with a single writer at any given time.
+    //
+    // All sigfs counters are updated while the queue lock is held,
+    // so there is never more than one thread updating a given
+    // counter. We can therefore use a relaxed load / store pair,
+    // which compiles to plain memory moves, instead of a locked
+    // read-modify-write instruction.
+    //
+    // Readers, such as the .stats virtual files, can read the
+    // counter at any time without taking the queue lock.
+    //
+    class Counter {
+    public:
+        Counter(void):
+            value_(0)
+        {
+        }
+
+        Counter(const Counter& org):
+            value_(org.get())
+        {
+        }
+
+        inline void add(const std::uint64_t value)
+        {
+            value_.store(value_.load(std::memory_order_relaxed) + value,
+                         std::memory_order_relaxed);
+        }
+
+        inline void increment(void)
+        {
+            add(1);
+        }
+
+        // Keep the greatest value ever provided.
+        inline void track_max(const std::uint64_t value)
+        {
+            if (value > value_.load(std::memory_order_relaxed))
+                value_.store(value, std::memory_order_relaxed);
+        }
+
+        inline std::uint64_t get(void) const
+        {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<std::uint64_t> value_;
+    };
+}
+#endif // __SIGFS_STATS__
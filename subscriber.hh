@@ -15,6 +15,7 @@
 #include <vector>
 #include <string.h>
 #include "queue.hh"
+#include "filter.hh"
 
 namespace sigfs {
     using index_t = std::int32_t;
@@ -44,8 +45,12 @@ namespace sigfs {
     //
     class Subscriber {
     public:
-        Subscriber(std::shared_ptr<Queue> queue):
+        // is_reader should be false for subscribers that only publish to
+        // the queue. They are then not tracked by the queue statistics.
+        //
+        Subscriber(std::shared_ptr<Queue> queue, const bool is_reader = true):
             queue_(queue),
+            is_reader_(is_reader),
             sig_id_(0),
             interrupted_(false)
         {
@@ -58,7 +63,9 @@ namespace sigfs {
         };
 
         virtual ~Subscriber(void)
-        {}
+        {
+            queue_->release_subscriber(*this);
+        }
 
 
         // Called by Queue when dequeue() has been called and freed up
@@ -112,12 +119,130 @@ namespace sigfs {
             return queue_->signal_available(*this);
         }
 
+        inline bool is_reader(void) const
+        {
+            return is_reader_;
+        }
+
+        // Statistics, updated by Queue::dequeue_signal()
+        inline void count_delivered(const std::uint64_t count)
+        {
+            signals_delivered_.add(count);
+        }
+
+        inline void count_lost(const std::uint64_t count)
+        {
+            signals_lost_.add(count);
+        }
+
+        inline std::uint64_t signals_delivered(void) const
+        {
+            return signals_delivered_.get();
+        }
+
+        inline std::uint64_t signals_lost(void) const
+        {
+            return signals_lost_.get();
+        }
+
+        // Signals skipped since they did not match filter()
+        inline void count_filtered(const std::uint64_t count)
+        {
+            signals_filtered_.add(count);
+        }
+
+        inline std::uint64_t signals_filtered(void) const
+        {
+            return signals_filtered_.get();
+        }
+
+        // Filter applied by Queue before delivering signals.
+        // Install with Queue::set_filter(), which holds the queue
+        // lock while the filter is replaced.
+        //
+        inline const SignalFilter& filter(void) const
+        {
+            return filter_;
+        }
+
+        inline void set_filter(const SignalFilter& filter)
+        {
+            filter_ = filter;
+        }
+
+        // Signals skipped by rate() and lag()
+        inline void count_skipped(const std::uint64_t count)
+        {
+            signals_skipped_.add(count);
+        }
+
+        inline std::uint64_t signals_skipped(void) const
+        {
+            return signals_skipped_.get();
+        }
+
+        // Rate limit applied by Queue before delivering signals.
+        // Install with Queue::set_rate().
+        //
+        inline const DeliveryRate& rate(void) const
+        {
+            return rate_;
+        }
+
+        inline void set_rate(const DeliveryRate& rate)
+        {
+            rate_ = rate;
+            rate_state_ = DeliveryRate::state_t();
+        }
+
+        // Rate limit state, updated by Queue as signals are delivered.
+        inline const DeliveryRate::state_t& rate_state(void) const
+        {
+            return rate_state_;
+        }
+
+        inline void set_rate_state(const DeliveryRate::state_t& state)
+        {
+            rate_state_ = state;
+        }
+
+        // Lag policy applied by Queue when sub starts reading.
+        // Install with Queue::set_lag().
+        //
+        inline const LagPolicy& lag(void) const
+        {
+            return lag_;
+        }
+
+        inline void set_lag(const LagPolicy& lag)
+        {
+            lag_ = lag;
+        }
+
 
     private:
+        // Read only after construction.
         std::shared_ptr<Queue> queue_;
-        signal_id_t sig_id_; // The Id of the next signal we are about to read.
         int sub_id_; // Used to color separate logging on a per subscribed basis
-        bool interrupted_; // Set to true to indicate that a dequeue_signal() has been interrupted.
+        const bool is_reader_; // False for publish-only subscribers.
+
+        // Written by the reading thread. Kept on its own cache
+        // line so that subscribers read by different threads do not
+        // share cursors with each other or with interrupted_.
+        alignas(cache_line_size) signal_id_t sig_id_; // The Id of the next signal we are about to read.
+        Counter signals_delivered_;
+        Counter signals_lost_;
+        Counter signals_filtered_;
+        Counter signals_skipped_;
+        DeliveryRate::state_t rate_state_;
+
+        // Read by the queue with the queue lock held.
+        SignalFilter filter_;
+        DeliveryRate rate_;
+        LagPolicy lag_;
+
+        // Written by the thread interrupting a dequeue_signal() call.
+        alignas(cache_line_size) bool interrupted_; // Set to true to indicate that a dequeue_signal() has been interrupted.
     };
 }
 #endif // __SIGFS_SUBSCRIBER__
@@ -0,0 +1,778 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+//
+// End-to-end FUSE benchmark of sigfs.
+//
+// For each set of FUSE options to compare, a sigfs process is
+// started on a temporary mount point and the following scenarios
+// are measured:
+//
+//   write_batch   - Signals written per write(2) vs. throughput.
+//   read_buffer   - read(2) buffer size vs. signals returned per read.
+//   wake_latency  - Publish to epoll_wait() wakeup and read latency.
+//   open_close    - open(2) + close(2) and stat(2) rates.
+//   idle_readers  - Throughput with N readers blocked in read(2) on
+//                   another file, each holding a FUSE worker thread.
+//
+// All measuring readers wait with epoll before they read, so that
+// no FUSE worker thread is blocked in do_read() while the scenario
+// runs. This allows the single threaded (-s) FUSE loop to be
+// benchmarked as well.
+//
+
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <cstdarg>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <map>
+#include "../log.h"
+#include "../sigfs_common.h"
+#include "../histogram.hh"
+
+namespace {
+    struct Config {
+        std::string sigfs_exe { "../sigfs" };
+        std::vector<std::string> variants { "-s", "", "-o clone_fd", "-o max_threads=4" };
+        std::vector<std::uint32_t> write_batches { 1, 10, 100 };
+        std::vector<std::uint32_t> read_buffers { 0, 4096, 65536 }; // 0 = a single signal
+        std::vector<std::uint32_t> idle_readers { 0, 2, 6 };
+        std::uint32_t payload_size { 64 };
+        std::uint32_t count { 100000 };
+        std::uint32_t warmup { 1000 };
+        std::uint32_t latency_count { 2000 };
+        std::uint32_t open_count { 10000 };
+        std::vector<int> cpus {};
+        std::vector<int> sigfs_cpus {};
+        enum { table, csv, json } format { table };
+    };
+
+    struct Record {
+        std::string variant;
+        std::string scenario;
+        std::string parameter;
+        std::string metric;
+        double value;
+    };
+
+    const char* prog_name = "sigfs_bench_fuse";
+
+    // Stops the running sigfs, if any, and removes its mount point.
+    void (*cleanup)(void) = nullptr;
+
+    void fail(const char* fmt, ...)
+    {
+        va_list ap;
+
+        va_start(ap, fmt);
+        fprintf(stderr, "%s: ", prog_name);
+        vfprintf(stderr, fmt, ap);
+        fprintf(stderr, "\n");
+        va_end(ap);
+
+        if (cleanup)
+            cleanup();
+
+        exit(1);
+    }
+
+    void usage(const char* name)
+    {
+        printf("Usage: %s [options]\n", name);
+        puts("  -e, --sigfs=<path>              sigfs executable. Default: ../sigfs");
+        puts("  -o, --fuse-options=<opt;...>    ';'-separated FUSE option sets to compare, each");
+        puts("                                  passed to sigfs. Default: \"-s;;-o clone_fd;-o max_threads=4\"");
+        puts("  -b, --write-batches=<n,...>     Signals per write(2).                      Default: 1,10,100");
+        puts("  -r, --read-buffers=<n,...>      read(2) buffer sizes, 0 for one signal.    Default: 0,4096,65536");
+        puts("  -i, --idle-readers=<n,...>      Blocked idle reader counts.                Default: 0,2,6");
+        puts("  -P, --payload-size=<n>          Payload size in bytes.                     Default: 64");
+        puts("  -c, --count=<n>                 Signals per throughput measurement.        Default: 100000");
+        puts("  -l, --latency-count=<n>         Signals per wake latency measurement.      Default: 2000");
+        puts("  -C, --cpus=<n,...>              CPUs to pin benchmark threads to.");
+        puts("  -S, --sigfs-cpus=<n,...>        CPUs to pin the sigfs process to.");
+        puts("      --csv                       Output one CSV line per measurement.");
+        puts("      --json                      Output JSON.");
+    }
+
+    template<typename T>
+    std::vector<T> parse_list(const char* name, const char* arg, const char sep = ',')
+    {
+        std::vector<T> res;
+        std::stringstream str(arg);
+        std::string elem;
+
+        while(std::getline(str, elem, sep)) {
+            char* end(nullptr);
+            long long val(strtoll(elem.c_str(), &end, 0));
+
+            if (elem.empty() || *end || val < 0)
+                fail("Invalid %s value: %s", name, elem.c_str());
+
+            res.push_back((T) val);
+        }
+        return res;
+    }
+
+    std::vector<std::string> split(const std::string& arg, const char sep)
+    {
+        std::vector<std::string> res;
+        std::stringstream str(arg);
+        std::string elem;
+
+        while(std::getline(str, elem, sep))
+            res.push_back(elem);
+
+        // "a;" yields a trailing empty element.
+        if (!arg.empty() && arg.back() == sep)
+            res.push_back("");
+
+        return res;
+    }
+
+    void pin(const std::vector<int>& cpus, pid_t pid = 0)
+    {
+        if (cpus.empty())
+            return;
+
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        for(auto cpu: cpus)
+            CPU_SET(cpu, &set);
+
+        if (sched_setaffinity(pid, sizeof(set), &set))
+            SIGFS_LOG_WARNING("Could not set CPU affinity: %s", strerror(errno));
+    }
+
+    std::uint64_t now(void)
+    {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (std::uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    std::string variant_name(const std::string& variant)
+    {
+        return variant.empty()?"default":variant;
+    }
+
+
+    //
+    // A sigfs process serving a temporary mount point.
+    //
+    class SigFS {
+    public:
+        SigFS(const Config& cfg, const std::string& variant):
+            pid_(-1)
+        {
+            active_ = this;
+            cleanup = []() { active_->stop(); };
+
+            char tmpl[] = "/tmp/sigfs-bench.XXXXXX";
+
+            if (!mkdtemp(tmpl))
+                fail("mkdtemp(): %s", strerror(errno));
+
+            dir_ = tmpl;
+            mount_ = dir_ + "/root";
+            config_ = dir_ + "/sigfs.json";
+
+            if (mkdir(mount_.c_str(), 0700))
+                fail("mkdir(%s): %s", mount_.c_str(), strerror(errno));
+
+            write_config();
+
+            std::vector<std::string> args { cfg.sigfs_exe, "-f", "-c", config_ };
+            std::stringstream opts(variant);
+            std::string opt;
+
+            while(opts >> opt)
+                args.push_back(opt);
+
+            args.push_back(mount_);
+
+            pid_ = fork();
+            if (pid_ == -1)
+                fail("fork(): %s", strerror(errno));
+
+            if (!pid_) {
+                std::vector<char*> argv;
+
+                for(auto& arg: args)
+                    argv.push_back((char*) arg.c_str());
+
+                argv.push_back(nullptr);
+                pin(cfg.sigfs_cpus);
+                setenv("SIGFS_LOG_LEVEL", "0", 1);
+                execv(argv[0], argv.data());
+                fprintf(stderr, "%s: execv(%s): %s\n", prog_name, argv[0], strerror(errno));
+                _exit(255);
+            }
+
+            // Wait for the mount to appear.
+            struct stat st;
+            for(int ind = 0; ind < 500; ++ind) {
+                if (!stat(path("bench").c_str(), &st))
+                    return;
+
+                int status(0);
+                if (waitpid(pid_, &status, WNOHANG) == pid_) {
+                    pid_ = -1;
+                    fail("%s exited with status %d before mounting %s",
+                         cfg.sigfs_exe.c_str(), WEXITSTATUS(status), mount_.c_str());
+                }
+
+                usleep(10000);
+            }
+            fail("Timed out waiting for sigfs to mount %s", mount_.c_str());
+        }
+
+        ~SigFS(void)
+        {
+            stop();
+            cleanup = nullptr;
+        }
+
+        void stop(void)
+        {
+            if (pid_ > 0) {
+                // The FUSE signal handlers unmount the file system.
+                kill(pid_, SIGHUP);
+                waitpid(pid_, nullptr, 0);
+                pid_ = -1;
+            }
+
+            rmdir(mount_.c_str());
+            unlink(config_.c_str());
+            rmdir(dir_.c_str());
+        }
+
+        std::string path(const char* file) const
+        {
+            return mount_ + "/" + file;
+        }
+
+    private:
+        void write_config(void)
+        {
+            FILE* out(fopen(config_.c_str(), "w"));
+
+            if (!out)
+                fail("fopen(%s): %s", config_.c_str(), strerror(errno));
+
+            fprintf(out,
+                    "{\n"
+                    "  \"root\": {\n"
+                    "    \"name\": \"/\",\n"
+                    "    \"uid_access\": [ { \"uid\": %u, \"access\": [ \"read\", \"write\", \"cascade\" ] } ],\n"
+                    "    \"entries\": [\n"
+                    "      { \"name\": \"bench\", \"queue_length\": 1048576 },\n"
+                    "      { \"name\": \"latency\", \"queue_length\": 1024 },\n"
+                    "      { \"name\": \"idle\", \"queue_length\": 1024 }\n"
+                    "    ]\n"
+                    "  }\n"
+                    "}\n",
+                    getuid());
+            fclose(out);
+        }
+
+        static SigFS* active_;
+        pid_t pid_;
+        std::string dir_;
+        std::string mount_;
+        std::string config_;
+    };
+
+    SigFS* SigFS::active_ = nullptr;
+
+    int open_file(const std::string& path, const int flags)
+    {
+        int fd(open(path.c_str(), flags));
+
+        if (fd == -1)
+            fail("open(%s): %s", path.c_str(), strerror(errno));
+
+        return fd;
+    }
+
+    // Write count signals, batch signals per write(2).
+    void publish(const int fd, std::uint32_t count, const std::uint32_t batch, const std::uint32_t payload_size)
+    {
+        std::vector<char> buf((sizeof(sigfs_payload_t) + payload_size) * batch, 'x');
+
+        for(std::uint32_t ind = 0; ind < batch; ++ind)
+            ((sigfs_payload_t*) (buf.data() + ind * (sizeof(sigfs_payload_t) + payload_size)))->payload_size = payload_size;
+
+        while(count) {
+            std::uint32_t sig_count(count < batch?count:batch);
+            ssize_t size((sizeof(sigfs_payload_t) + payload_size) * sig_count);
+
+            if (write(fd, buf.data(), size) != size)
+                fail("write(%ld): %s", size, strerror(errno));
+
+            count -= sig_count;
+        }
+    }
+
+    // Read signals until count signals have been received or lost.
+    // Returns the number of read(2) calls made.
+    //
+    std::uint64_t drain(const int fd, const std::uint64_t count, const std::uint32_t buf_size)
+    {
+        std::vector<char> buf(buf_size);
+        struct pollfd pfd { .fd = fd, .events = POLLIN, .revents = 0 };
+        std::uint64_t received(0);
+        std::uint64_t reads(0);
+
+        while(received < count) {
+            int res(poll(&pfd, 1, 5000));
+
+            if (res == 0)
+                fail("Timed out after receiving %lu of %lu signals", received, count);
+
+            if (res == -1)
+                fail("poll(): %s", strerror(errno));
+
+            ssize_t rd_res(read(fd, buf.data(), buf.size()));
+
+            if (rd_res == -1)
+                fail("read(): %s", strerror(errno));
+
+            ++reads;
+            ssize_t offset(0);
+            while(offset < rd_res) {
+                sigfs_signal_t* sig((sigfs_signal_t*) (buf.data() + offset));
+
+                received += 1 + sig->lost_signals;
+                offset += SIGFS_SIGNAL_SIZE(sig);
+            }
+        }
+        return reads;
+    }
+
+    std::uint32_t one_signal_buffer(const Config& cfg)
+    {
+        return sizeof(sigfs_signal_t) + cfg.payload_size;
+    }
+
+    // Throughput, in signals / sec, of a single publisher
+    // writing cfg.count signals to a single reader.
+    double measure_throughput(const Config& cfg, const SigFS& fs, const std::uint32_t batch)
+    {
+        int rd_fd(open_file(fs.path("bench"), O_RDONLY));
+        int wr_fd(open_file(fs.path("bench"), O_WRONLY));
+
+        // Warm up the FUSE worker threads and the queue slots.
+        publish(wr_fd, cfg.warmup, batch, cfg.payload_size);
+        drain(rd_fd, cfg.warmup, 65536);
+
+        std::uint64_t start(now());
+        std::thread reader(
+            [&cfg, rd_fd]() {
+                pin(cfg.cpus);
+                drain(rd_fd, cfg.count, 65536);
+            });
+
+        publish(wr_fd, cfg.count, batch, cfg.payload_size);
+        reader.join();
+
+        std::uint64_t elapsed(now() - start);
+
+        close(wr_fd);
+        close(rd_fd);
+        return (double) cfg.count / ((double) elapsed / 1e9);
+    }
+
+    void bench_write_batch(const Config& cfg, const SigFS& fs, const std::string& variant, std::vector<Record>& res)
+    {
+        for(auto batch: cfg.write_batches)
+            res.push_back({ variant, "write_batch", "batch=" + std::to_string(batch),
+                            "signals_per_sec", measure_throughput(cfg, fs, batch) });
+    }
+
+    void bench_read_buffer(const Config& cfg, const SigFS& fs, const std::string& variant, std::vector<Record>& res)
+    {
+        for(auto buf_size: cfg.read_buffers) {
+            if (!buf_size)
+                buf_size = one_signal_buffer(cfg);
+
+            int rd_fd(open_file(fs.path("bench"), O_RDONLY));
+            int wr_fd(open_file(fs.path("bench"), O_WRONLY));
+
+            // Queue all signals before reading so that every read
+            // can be filled.
+            publish(wr_fd, cfg.count, 100, cfg.payload_size);
+
+            std::uint64_t start(now());
+            std::uint64_t reads(drain(rd_fd, cfg.count, buf_size));
+            std::uint64_t elapsed(now() - start);
+            std::string param("buffer=" + std::to_string(buf_size));
+
+            res.push_back({ variant, "read_buffer", param, "signals_per_read", (double) cfg.count / reads });
+            res.push_back({ variant, "read_buffer", param, "signals_per_sec",
+                            (double) cfg.count / ((double) elapsed / 1e9) });
+            close(wr_fd);
+            close(rd_fd);
+        }
+    }
+
+    void bench_wake_latency(const Config& cfg, const SigFS& fs, const std::string& variant, std::vector<Record>& res)
+    {
+        int rd_fd(open_file(fs.path("latency"), O_RDONLY));
+        int wr_fd(open_file(fs.path("latency"), O_WRONLY));
+        uint32_t read_options(SIGFS_READ_OPT_TIMESTAMP);
+        sigfs::Histogram wake_latency;
+        sigfs::Histogram read_latency;
+        std::atomic<std::uint32_t> received(0);
+
+        if (ioctl(rd_fd, SIGFS_IOC_SET_READ_OPTIONS, &read_options) == -1)
+            fail("ioctl(SIGFS_IOC_SET_READ_OPTIONS): %s", strerror(errno));
+
+        int epfd(epoll_create1(0));
+        struct epoll_event ev {};
+
+        ev.events = EPOLLIN;
+        ev.data.fd = rd_fd;
+        if (epfd == -1 || epoll_ctl(epfd, EPOLL_CTL_ADD, rd_fd, &ev))
+            fail("epoll setup: %s", strerror(errno));
+
+        std::thread reader(
+            [&cfg, &wake_latency, &read_latency, &received, epfd, rd_fd]() {
+                char buf[65536];
+                struct epoll_event ev;
+
+                pin(cfg.cpus);
+                while(received < cfg.latency_count) {
+                    int res(epoll_wait(epfd, &ev, 1, 5000));
+
+                    if (res <= 0)
+                        fail("epoll_wait() timed out or failed: %s", strerror(errno));
+
+                    std::uint64_t woken(now());
+                    ssize_t rd_res(read(rd_fd, buf, sizeof(buf)));
+                    std::uint64_t done(now());
+                    ssize_t offset(0);
+
+                    if (rd_res == -1)
+                        fail("read(): %s", strerror(errno));
+
+                    while(offset < rd_res) {
+                        sigfs_signal_ts_t* sig((sigfs_signal_ts_t*) (buf + offset));
+
+                        wake_latency.record(woken - sig->publish_time);
+                        read_latency.record(done - sig->publish_time);
+                        offset += SIGFS_SIGNAL_TS_SIZE(sig);
+                        received++;
+                    }
+                }
+            });
+
+        // Ping-pong a single signal at a time, giving the reader
+        // time to get back into epoll_wait() between signals.
+        for(std::uint32_t ind = 0; ind < cfg.latency_count; ++ind) {
+            publish(wr_fd, 1, 1, cfg.payload_size);
+
+            while(received.load() <= ind)
+                std::this_thread::yield();
+
+            usleep(100);
+        }
+        reader.join();
+
+        for(auto& [name, hist]: { std::make_pair("wake", &wake_latency),
+                                  std::make_pair("read", &read_latency) }) {
+            std::string param(name);
+
+            res.push_back({ variant, "wake_latency", param, "p50_nsec", (double) hist->percentile(50.0) });
+            res.push_back({ variant, "wake_latency", param, "p99_nsec", (double) hist->percentile(99.0) });
+            res.push_back({ variant, "wake_latency", param, "p999_nsec", (double) hist->percentile(99.9) });
+            res.push_back({ variant, "wake_latency", param, "max_nsec", (double) hist->max() });
+        }
+
+        close(epfd);
+        close(wr_fd);
+        close(rd_fd);
+    }
+
+    void bench_open_close(const Config& cfg, const SigFS& fs, const std::string& variant, std::vector<Record>& res)
+    {
+        std::string path(fs.path("bench"));
+        std::uint64_t start(now());
+
+        for(std::uint32_t ind = 0; ind < cfg.open_count; ++ind)
+            close(open_file(path, O_RDONLY));
+
+        res.push_back({ variant, "open_close", "open+close", "ops_per_sec",
+                        (double) cfg.open_count / ((double) (now() - start) / 1e9) });
+
+        struct stat st;
+        start = now();
+        for(std::uint32_t ind = 0; ind < cfg.open_count; ++ind)
+            if (stat(path.c_str(), &st))
+                fail("stat(%s): %s", path.c_str(), strerror(errno));
+
+        res.push_back({ variant, "open_close", "stat", "ops_per_sec",
+                        (double) cfg.open_count / ((double) (now() - start) / 1e9) });
+    }
+
+    void bench_idle_readers(const Config& cfg, const SigFS& fs, const std::string& variant, std::vector<Record>& res)
+    {
+        // Each blocked reader holds a FUSE worker thread. Leave room
+        // for the measuring publisher and reader.
+        std::uint32_t max_threads(10);
+        std::string::size_type pos(variant.find("max_threads="));
+
+        if (pos != std::string::npos)
+            max_threads = std::atoi(variant.c_str() + pos + strlen("max_threads="));
+
+        std::stringstream opts(variant);
+        std::string opt;
+
+        while(opts >> opt)
+            if (opt == "-s")
+                max_threads = 1;
+
+        for(auto idle: cfg.idle_readers) {
+            std::string param("idle=" + std::to_string(idle));
+
+            if (idle && idle + 2 > max_threads) {
+                SIGFS_LOG_WARNING("%s: Skipping %u idle readers with %u FUSE worker threads",
+                                  variant_name(variant).c_str(), idle, max_threads);
+                continue;
+            }
+
+            std::vector<std::thread> readers;
+            std::atomic<std::uint32_t> started(0);
+
+            for(std::uint32_t ind = 0; ind < idle; ++ind) {
+                readers.emplace_back(
+                    [&fs, &started]() {
+                        int fd(open_file(fs.path("idle"), O_RDONLY));
+                        char buf[4096];
+
+                        started++;
+                        if (read(fd, buf, sizeof(buf)) == -1)
+                            fail("Idle read(): %s", strerror(errno));
+                        close(fd);
+                    });
+            }
+
+            // Wait for the readers to block in read(2).
+            while(started.load() < idle)
+                std::this_thread::yield();
+            usleep(100000);
+
+            res.push_back({ variant, "idle_readers", param, "signals_per_sec",
+                            measure_throughput(cfg, fs, 10) });
+
+            // Release the idle readers.
+            if (idle) {
+                int fd(open_file(fs.path("idle"), O_WRONLY));
+                publish(fd, 1, 1, cfg.payload_size);
+                close(fd);
+            }
+
+            for(auto& thr: readers)
+                thr.join();
+        }
+    }
+
+    void print_csv(const std::vector<Record>& records)
+    {
+        puts("fuse_options,scenario,parameter,metric,value");
+        for(auto& rec: records)
+            printf("\"%s\",%s,%s,%s,%.2f\n",
+                   variant_name(rec.variant).c_str(), rec.scenario.c_str(),
+                   rec.parameter.c_str(), rec.metric.c_str(), rec.value);
+    }
+
+    void print_json(const std::vector<Record>& records)
+    {
+        printf("{\n  \"benchmark\": \"fuse\",\n  \"results\": [");
+        for(size_t ind = 0; ind < records.size(); ++ind) {
+            auto& rec(records[ind]);
+
+            printf("%s\n    { \"fuse_options\": \"%s\", \"scenario\": \"%s\", \"parameter\": \"%s\", "
+                   "\"metric\": \"%s\", \"value\": %.2f }",
+                   ind?",":"",
+                   variant_name(rec.variant).c_str(), rec.scenario.c_str(),
+                   rec.parameter.c_str(), rec.metric.c_str(), rec.value);
+        }
+        printf("\n  ]\n}\n");
+    }
+
+    // One row per measurement, one column per set of FUSE options.
+    void print_table(const Config& cfg, const std::vector<Record>& records)
+    {
+        std::vector<std::string> rows;
+        std::map<std::string, std::map<std::string, double>> values;
+
+        for(auto& rec: records) {
+            std::string row(rec.scenario + " " + rec.parameter + " " + rec.metric);
+
+            if (!values.count(row))
+                rows.push_back(row);
+
+            values[row][rec.variant] = rec.value;
+        }
+
+        printf("%-44s", "scenario parameter metric");
+        for(auto& variant: cfg.variants)
+            printf(" %18s", variant_name(variant).c_str());
+        puts("");
+
+        for(auto& row: rows) {
+            printf("%-44s", row.c_str());
+            for(auto& variant: cfg.variants) {
+                auto val(values[row].find(variant));
+
+                if (val == values[row].end())
+                    printf(" %18s", "-");
+                else
+                    printf(" %18.2f", val->second);
+            }
+            puts("");
+        }
+    }
+}
+
+int main(int argc,  char *const* argv)
+{
+    int ch = 0;
+    static struct option long_options[] =  {
+        {"sigfs", required_argument, NULL, 'e'},
+        {"fuse-options", required_argument, NULL, 'o'},
+        {"write-batches", required_argument, NULL, 'b'},
+        {"read-buffers", required_argument, NULL, 'r'},
+        {"idle-readers", required_argument, NULL, 'i'},
+        {"payload-size", required_argument, NULL, 'P'},
+        {"count", required_argument, NULL, 'c'},
+        {"latency-count", required_argument, NULL, 'l'},
+        {"cpus", required_argument, NULL, 'C'},
+        {"sigfs-cpus", required_argument, NULL, 'S'},
+        {"csv", no_argument, NULL, 1},
+        {"json", no_argument, NULL, 2},
+        {NULL, 0, NULL, 0}
+    };
+    Config cfg;
+
+    prog_name = argv[0];
+    while ((ch = getopt_long(argc, argv, "e:o:b:r:i:P:c:l:C:S:", long_options, NULL)) != -1) {
+        switch (ch)
+        {
+        case 'e':
+            cfg.sigfs_exe = optarg;
+            break;
+
+        case 'o':
+            cfg.variants = split(optarg, ';');
+            break;
+
+        case 'b':
+            cfg.write_batches = parse_list<std::uint32_t>("write batch", optarg);
+            break;
+
+        case 'r':
+            cfg.read_buffers = parse_list<std::uint32_t>("read buffer", optarg);
+            break;
+
+        case 'i':
+            cfg.idle_readers = parse_list<std::uint32_t>("idle reader", optarg);
+            break;
+
+        case 'P':
+            cfg.payload_size = std::atoi(optarg);
+            break;
+
+        case 'c':
+            cfg.count = std::atoi(optarg);
+            break;
+
+        case 'l':
+            cfg.latency_count = std::atoi(optarg);
+            break;
+
+        case 'C':
+            cfg.cpus = parse_list<int>("cpu", optarg);
+            break;
+
+        case 'S':
+            cfg.sigfs_cpus = parse_list<int>("sigfs cpu", optarg);
+            break;
+
+        case 1:
+            cfg.format = Config::csv;
+            break;
+
+        case 2:
+            cfg.format = Config::json;
+            break;
+
+        default:
+            usage(argv[0]);
+            exit(255);
+        }
+    }
+
+    if (sigfs_log_level_get() == SIGFS_LOG_LEVEL_NONE)
+        sigfs_log_level_set(SIGFS_LOG_LEVEL_WARNING);
+
+    if (access(cfg.sigfs_exe.c_str(), X_OK))
+        fail("Cannot execute %s: %s", cfg.sigfs_exe.c_str(), strerror(errno));
+
+    if (cfg.variants.empty())
+        cfg.variants.push_back("");
+
+    pin(cfg.cpus);
+
+    std::vector<Record> records;
+
+    for(auto& variant: cfg.variants) {
+        SIGFS_LOG_INFO("Benchmarking sigfs %s", variant_name(variant).c_str());
+        SigFS fs(cfg, variant);
+
+        bench_write_batch(cfg, fs, variant, records);
+        bench_read_buffer(cfg, fs, variant, records);
+        bench_wake_latency(cfg, fs, variant, records);
+        bench_open_close(cfg, fs, variant, records);
+        bench_idle_readers(cfg, fs, variant, records);
+    }
+
+    switch(cfg.format) {
+    case Config::csv:
+        print_csv(records);
+        break;
+
+    case Config::json:
+        print_json(records);
+        break;
+
+    default:
+        print_table(cfg, records);
+    }
+
+    exit(0);
+}
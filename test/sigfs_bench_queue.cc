@@ -0,0 +1,506 @@
+// Copyright (C) 2023, Magnus Feuer
+// This program is licensed under the terms and conditions of the
+// Mozilla Public License, version 2.0.  The full text of the
+// Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+//
+// Author: Magnus Feuer (magnus@feuerworks.com)
+//
+
+//
+// Queue microbenchmark suite.
+//
+// Runs every combination of the given payload sizes, queue lengths,
+// publisher counts, subscriber counts, and callback batch sizes, and
+// reports throughput, publish-to-callback latency percentiles, and
+// lost signal rates as CSV or JSON.
+//
+// Each thread is pinned to a CPU. Subscribers only record counters
+// and latencies inside the timed loop. Signal sequences are verified
+// once all threads have been joined.
+//
+
+#include <getopt.h>
+#include "../queue_impl.hh"
+#include "../subscriber.hh"
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+using namespace sigfs;
+
+namespace {
+    struct Config {
+        std::vector<std::uint32_t> payload_sizes { 8, 64, 512, 4096, 65536 };
+        std::vector<std::uint32_t> queue_lengths { 1024, 16384 };
+        std::vector<std::uint32_t> publishers { 1, 2 };
+        std::vector<std::uint32_t> subscribers { 1, 4 };
+        std::vector<std::uint32_t> batches { 1, 0 };
+        std::vector<Queue::Config> engines { Queue::Config() };
+        std::vector<int> cpus {};
+        std::uint32_t count { 100000 };
+        std::uint64_t max_queue_bytes { 256ULL * 1024 * 1024 };
+        bool json { false };
+        bool contention { false };
+    };
+
+    struct Result {
+        const char* sync;
+        const char* storage;
+        std::uint32_t payload_size;
+        std::uint32_t queue_length;
+        std::uint32_t publishers;
+        std::uint32_t subscribers;
+        std::uint32_t batch;
+        std::uint64_t signals;       // Published signals
+        std::uint64_t elapsed_usec;
+        double signals_per_sec;      // Published signals / sec
+        double mbytes_per_sec;       // Published payload MB / sec
+        std::uint64_t delivered;     // Total for all subscribers
+        std::uint64_t lost;          // Total for all subscribers
+        double lost_rate;            // lost / (delivered + lost)
+        std::uint64_t lat_p50;
+        std::uint64_t lat_p99;
+        std::uint64_t lat_p999;
+        std::uint64_t lat_max;
+    };
+
+    // Per-subscriber state, updated only by the subscriber thread.
+    struct SubscriberResult {
+        std::uint64_t delivered { 0 };
+        std::uint64_t lost { 0 };
+        signal_id_t last_sig_id { 0 };
+        bool out_of_order { false };
+        Histogram latency;
+    };
+
+    void usage(const char* name)
+    {
+        std::cout << "Usage: " << name << " [options]" << std::endl;
+        std::cout << "  -P, --payload-sizes=<n,...>   Payload sizes in bytes.             Default: 8,64,512,4096,65536" << std::endl;
+        std::cout << "  -q, --queue-lengths=<n,...>   Queue lengths, powers of 2.         Default: 1024,16384" << std::endl;
+        std::cout << "  -p, --publishers=<n,...>      Publisher thread counts.            Default: 1,2" << std::endl;
+        std::cout << "  -s, --subscribers=<n,...>     Subscriber thread counts.           Default: 1,4" << std::endl;
+        std::cout << "  -b, --batches=<n,...>         Max signals per dequeue_signal()," << std::endl;
+        std::cout << "                                0 for as many as available.         Default: 1,0" << std::endl;
+        std::cout << "  -e, --engines=<sync/storage,...>" << std::endl;
+        std::cout << "                                Queue sync and storage policies," << std::endl;
+        std::cout << "                                or \"all\" for every combination.   Default: mutex/heap" << std::endl;
+        std::cout << "  -c, --count=<n>               Signals sent by each publisher.     Default: 100000" << std::endl;
+        std::cout << "  -C, --cpus=<n,...>            CPUs to pin threads to, assigned round robin to" << std::endl;
+        std::cout << "                                publishers and then subscribers.    Default: all online CPUs" << std::endl;
+        std::cout << "  -m, --max-queue-mbytes=<n>    Skip runs whose queue_length * payload size" << std::endl;
+        std::cout << "                                exceeds this.                       Default: 256" << std::endl;
+        std::cout << "  -x, --contention              Cache line contention scenario: 8 byte payloads," << std::endl;
+        std::cout << "                                one signal per callback, one publisher and" << std::endl;
+        std::cout << "                                1, 2, 4, ... subscribers, each on its own CPU." << std::endl;
+        std::cout << "                                Run under \"perf c2c record\" to see shared lines." << std::endl;
+        std::cout << "  -j, --json                    Output JSON instead of CSV." << std::endl;
+    }
+
+    template<typename T>
+    std::vector<T> parse_list(const char* name, const char* arg)
+    {
+        std::vector<T> res;
+        std::stringstream str(arg);
+        std::string elem;
+
+        while(std::getline(str, elem, ',')) {
+            char* end(nullptr);
+            long long val(strtoll(elem.c_str(), &end, 0));
+
+            if (elem.empty() || *end || val < 0) {
+                std::cerr << "Invalid " << name << " value: " << elem << std::endl;
+                exit(255);
+            }
+            res.push_back((T) val);
+        }
+
+        if (res.empty()) {
+            std::cerr << "Empty " << name << " list" << std::endl;
+            exit(255);
+        }
+        return res;
+    }
+
+    std::vector<Queue::Config> parse_engines(const char* arg)
+    {
+        std::vector<Queue::Config> res;
+        std::stringstream str(arg);
+        std::string elem;
+
+        if (!strcmp(arg, "all")) {
+            for(auto sync: { "mutex", "spin" })
+                for(auto storage: { "heap", "arena", "inline" }) {
+                    Queue::Config cfg;
+
+                    Queue::Config::parse_sync(sync, cfg.sync);
+                    Queue::Config::parse_storage(storage, cfg.storage);
+                    res.push_back(cfg);
+                }
+            return res;
+        }
+
+        while(std::getline(str, elem, ',')) {
+            Queue::Config cfg;
+            const size_t sep(elem.find('/'));
+
+            if (sep == std::string::npos ||
+                !Queue::Config::parse_sync(elem.substr(0, sep), cfg.sync) ||
+                !Queue::Config::parse_storage(elem.substr(sep + 1), cfg.storage)) {
+                std::cerr << "Invalid engine: " << elem
+                          << ". Use <mutex|spin>/<heap|arena|inline>." << std::endl;
+                exit(255);
+            }
+            res.push_back(cfg);
+        }
+
+        if (res.empty()) {
+            std::cerr << "Empty engine list" << std::endl;
+            exit(255);
+        }
+        return res;
+    }
+
+    void pin_thread(const Config& cfg, const int thread_ind)
+    {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cfg.cpus[thread_ind % cfg.cpus.size()], &set);
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+            SIGFS_LOG_WARNING("Could not pin thread %d to CPU %d",
+                              thread_ind, cfg.cpus[thread_ind % cfg.cpus.size()]);
+    }
+
+    void wait_for_start(const std::atomic<bool>& start)
+    {
+        while(!start.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    Result run(const Config& cfg,
+               const Queue::Config& engine,
+               const std::uint32_t payload_size,
+               const std::uint32_t queue_length,
+               const std::uint32_t nr_publishers,
+               const std::uint32_t nr_subscribers,
+               const std::uint32_t batch)
+    {
+        auto queue(std::make_shared<Queue>(queue_length, 0, engine));
+        const std::uint64_t total(std::uint64_t(cfg.count) * nr_publishers);
+        std::vector<std::unique_ptr<Subscriber>> subs;
+        std::vector<SubscriberResult> sub_res(nr_subscribers);
+        std::vector<std::thread> threads;
+        std::atomic<bool> start(false);
+
+        // Setup subscribers before anything is published so that
+        // they all start reading at the first signal.
+        for(std::uint32_t ind = 0; ind < nr_subscribers; ++ind)
+            subs.push_back(std::make_unique<Subscriber>(queue));
+
+        for(std::uint32_t ind = 0; ind < nr_subscribers; ++ind) {
+            threads.emplace_back(
+                [&cfg, &queue, &subs, &sub_res, &start,
+                 ind, nr_publishers, total, batch]() {
+                    pin_thread(cfg, nr_publishers + ind);
+
+                    SubscriberResult& res(sub_res[ind]);
+                    std::uint32_t in_batch(0);
+                    auto cb =
+                        [&res, &in_batch, batch]
+                        (signal_id_t signal_id,
+                         const char* payload,
+                         std::uint32_t payload_size,
+                         signal_count_t lost_signals,
+                         signal_count_t remaining_signal_count,
+                         std::uint64_t publish_time) -> Queue::cb_result_t {
+
+                            res.latency.record(Queue::timestamp() - publish_time);
+
+                            if (signal_id <= res.last_sig_id)
+                                res.out_of_order = true;
+
+                            res.last_sig_id = signal_id;
+                            res.lost += lost_signals;
+                            res.delivered++;
+
+                            if (batch && ++in_batch >= batch)
+                                return Queue::cb_result_t::processed_dont_call_again;
+
+                            return Queue::cb_result_t::processed_call_again;
+                        };
+
+                    wait_for_start(start);
+
+                    while(res.delivered + res.lost < total) {
+                        in_batch = 0;
+                        queue->dequeue_signal(*subs[ind], cb);
+                    }
+                });
+        }
+
+        for(std::uint32_t ind = 0; ind < nr_publishers; ++ind) {
+            threads.emplace_back(
+                [&cfg, &queue, &start, ind, payload_size]() {
+                    pin_thread(cfg, ind);
+
+                    std::vector<char> payload(payload_size, 'x');
+
+                    wait_for_start(start);
+
+                    for(std::uint32_t sig = 0; sig < cfg.count; ++sig)
+                        queue->queue_signal(payload.data(), payload_size);
+                });
+        }
+
+        const std::uint64_t start_time(Queue::timestamp());
+        start.store(true, std::memory_order_release);
+
+        for(auto& thr: threads)
+            thr.join();
+
+        const std::uint64_t elapsed(Queue::timestamp() - start_time);
+
+        //
+        // Verify the runs outside of the timed loop.
+        //
+        Result res {};
+        Histogram latency;
+
+        for(std::uint32_t ind = 0; ind < nr_subscribers; ++ind) {
+            if (sub_res[ind].out_of_order) {
+                SIGFS_LOG_FATAL("Subscriber %u received signals out of order", ind);
+                exit(1);
+            }
+
+            if (sub_res[ind].delivered + sub_res[ind].lost != total) {
+                SIGFS_LOG_FATAL("Subscriber %u: delivered[%lu] + lost[%lu] != published[%lu]",
+                                ind, sub_res[ind].delivered, sub_res[ind].lost, total);
+                exit(1);
+            }
+
+            latency.add(sub_res[ind].latency);
+            res.delivered += sub_res[ind].delivered;
+            res.lost += sub_res[ind].lost;
+        }
+
+        if (queue->statistics().signals_published != total) {
+            SIGFS_LOG_FATAL("Queue reports %lu signals published. Expected %lu",
+                            queue->statistics().signals_published, total);
+            exit(1);
+        }
+
+        res.sync = engine.sync_name();
+        res.storage = engine.storage_name();
+        res.payload_size = payload_size;
+        res.queue_length = queue_length;
+        res.publishers = nr_publishers;
+        res.subscribers = nr_subscribers;
+        res.batch = batch;
+        res.signals = total;
+        res.elapsed_usec = elapsed / 1000;
+        res.signals_per_sec = (double) total / ((double) elapsed / 1e9);
+        res.mbytes_per_sec = res.signals_per_sec * payload_size / 1e6;
+        res.lost_rate = (double) res.lost / (double) (res.delivered + res.lost);
+        res.lat_p50 = latency.percentile(50.0);
+        res.lat_p99 = latency.percentile(99.0);
+        res.lat_p999 = latency.percentile(99.9);
+        res.lat_max = latency.max();
+        return res;
+    }
+
+    void print_csv_header(void)
+    {
+        printf("sync,storage,payload_size,queue_length,publishers,subscribers,batch,signals,elapsed_usec,"
+               "signals_per_sec,mbytes_per_sec,delivered,lost,lost_rate,"
+               "latency_p50_nsec,latency_p99_nsec,latency_p999_nsec,latency_max_nsec\n");
+    }
+
+    void print_csv(const Result& res)
+    {
+        printf("%s,%s,%u,%u,%u,%u,%u,%lu,%lu,%.0f,%.2f,%lu,%lu,%.6f,%lu,%lu,%lu,%lu\n",
+               res.sync, res.storage, res.payload_size, res.queue_length, res.publishers, res.subscribers, res.batch,
+               res.signals, res.elapsed_usec, res.signals_per_sec, res.mbytes_per_sec,
+               res.delivered, res.lost, res.lost_rate,
+               res.lat_p50, res.lat_p99, res.lat_p999, res.lat_max);
+        fflush(stdout);
+    }
+
+    void print_json(const std::vector<Result>& results)
+    {
+        printf("{\n  \"benchmark\": \"queue\",\n  \"runs\": [");
+
+        for(size_t ind = 0; ind < results.size(); ++ind) {
+            const Result& res(results[ind]);
+
+            printf("%s\n    { \"sync\": \"%s\", \"storage\": \"%s\", \"payload_size\": %u, \"queue_length\": %u, \"publishers\": %u, "
+                   "\"subscribers\": %u, \"batch\": %u, \"signals\": %lu, \"elapsed_usec\": %lu, "
+                   "\"signals_per_sec\": %.0f, \"mbytes_per_sec\": %.2f, \"delivered\": %lu, "
+                   "\"lost\": %lu, \"lost_rate\": %.6f, \"latency_p50_nsec\": %lu, "
+                   "\"latency_p99_nsec\": %lu, \"latency_p999_nsec\": %lu, \"latency_max_nsec\": %lu }",
+                   ind?",":"",
+                   res.sync, res.storage, res.payload_size, res.queue_length, res.publishers, res.subscribers, res.batch,
+                   res.signals, res.elapsed_usec, res.signals_per_sec, res.mbytes_per_sec,
+                   res.delivered, res.lost, res.lost_rate,
+                   res.lat_p50, res.lat_p99, res.lat_p999, res.lat_max);
+        }
+        printf("\n  ]\n}\n");
+    }
+}
+
+int main(int argc,  char *const* argv)
+{
+    int ch = 0;
+    static struct option long_options[] =  {
+        {"payload-sizes", required_argument, NULL, 'P'},
+        {"queue-lengths", required_argument, NULL, 'q'},
+        {"publishers", required_argument, NULL, 'p'},
+        {"subscribers", required_argument, NULL, 's'},
+        {"batches", required_argument, NULL, 'b'},
+        {"engines", required_argument, NULL, 'e'},
+        {"count", required_argument, NULL, 'c'},
+        {"cpus", required_argument, NULL, 'C'},
+        {"max-queue-mbytes", required_argument, NULL, 'm'},
+        {"contention", no_argument, NULL, 'x'},
+        {"json", no_argument, NULL, 'j'},
+        {NULL, 0, NULL, 0}
+    };
+    Config cfg;
+
+    while ((ch = getopt_long(argc, argv, "P:q:p:s:b:e:c:C:m:xj", long_options, NULL)) != -1) {
+        switch (ch)
+        {
+        case 'P':
+            cfg.payload_sizes = parse_list<std::uint32_t>("payload size", optarg);
+            break;
+
+        case 'q':
+            cfg.queue_lengths = parse_list<std::uint32_t>("queue length", optarg);
+            break;
+
+        case 'p':
+            cfg.publishers = parse_list<std::uint32_t>("publisher count", optarg);
+            break;
+
+        case 's':
+            cfg.subscribers = parse_list<std::uint32_t>("subscriber count", optarg);
+            break;
+
+        case 'b':
+            cfg.batches = parse_list<std::uint32_t>("batch", optarg);
+            break;
+
+        case 'e':
+            cfg.engines = parse_engines(optarg);
+            break;
+
+        case 'c':
+            cfg.count = std::atoi(optarg);
+            break;
+
+        case 'C':
+            cfg.cpus = parse_list<int>("cpu", optarg);
+            break;
+
+        case 'm':
+            cfg.max_queue_bytes = std::strtoull(optarg, nullptr, 0) * 1024 * 1024;
+            break;
+
+        case 'x':
+            cfg.contention = true;
+            break;
+
+        case 'j':
+            cfg.json = true;
+            break;
+
+        default:
+            usage(argv[0]);
+            exit(255);
+        }
+    }
+
+    if (sigfs_log_level_get() == SIGFS_LOG_LEVEL_NONE)
+        sigfs_log_level_set(SIGFS_LOG_LEVEL_WARNING);
+
+    sigfs_log_set_start_time();
+
+    for(auto queue_length: cfg.queue_lengths) {
+        if (queue_length < 4 || (queue_length & (queue_length - 1))) {
+            std::cerr << "queue-length " << queue_length << " is not a power of 2 >= 4" << std::endl;
+            exit(255);
+        }
+    }
+
+    if (!cfg.count) {
+        std::cerr << "count must be greater than 0" << std::endl;
+        exit(255);
+    }
+
+    // Default to all online CPUs.
+    if (cfg.cpus.empty()) {
+        long cpu_count(sysconf(_SC_NPROCESSORS_ONLN));
+
+        for(long cpu = 0; cpu < cpu_count; ++cpu)
+            cfg.cpus.push_back(cpu);
+    }
+
+    // One publisher and up to one subscriber per remaining CPU, all
+    // hitting the queue with the smallest possible amount of work
+    // per signal.
+    if (cfg.contention) {
+        cfg.payload_sizes = { 8 };
+        cfg.queue_lengths = { 16384 };
+        cfg.publishers = { 1 };
+        cfg.batches = { 1 };
+        cfg.subscribers.clear();
+
+        for(std::uint32_t nr_subscribers = 1; nr_subscribers < cfg.cpus.size(); nr_subscribers *= 2)
+            cfg.subscribers.push_back(nr_subscribers);
+
+        if (cfg.subscribers.empty())
+            cfg.subscribers.push_back(1);
+    }
+
+    std::vector<Result> results;
+
+    if (!cfg.json)
+        print_csv_header();
+
+    for(auto& engine: cfg.engines)
+        for(auto payload_size: cfg.payload_sizes)
+            for(auto queue_length: cfg.queue_lengths) {
+                if (std::uint64_t(payload_size) * queue_length > cfg.max_queue_bytes) {
+                    SIGFS_LOG_WARNING("Skipping payload size %u with queue length %u: exceeds --max-queue-mbytes",
+                                      payload_size, queue_length);
+                    continue;
+                }
+
+                for(auto nr_publishers: cfg.publishers)
+                    for(auto nr_subscribers: cfg.subscribers)
+                        for(auto batch: cfg.batches) {
+                            Result res(run(cfg, engine, payload_size, queue_length,
+                                           nr_publishers, nr_subscribers, batch));
+
+                            if (cfg.json)
+                                results.push_back(res);
+                            else
+                                print_csv(res);
+                        }
+            }
+
+    if (cfg.json)
+        print_json(results);
+
+    exit(0);
+}
@@ -0,0 +1,366 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2023, Magnus Feuer
+# This program is licensed under the terms and conditions of the
+# Mozilla Public License, version 2.0.  The full text of the
+# Mozilla Public License is at https://www.mozilla.org/MPL/2.0/
+#
+# Author: Magnus Feuer (magnus@feuerworks.com)
+#
+
+#
+# Performance regression gate.
+#
+# Runs sigfs_test_queue_speed and sigfs_test_fuse for a fixed set of
+# scenarios, pinned to a fixed set of CPUs with taskset(1), and
+# compares the median of several runs of each scenario against a
+# baseline file.
+#
+# A scenario regresses when its throughput drops, or its p99 latency
+# grows, by more than the given threshold or by more than the run to
+# run noise of the baseline and the current runs, whichever is larger.
+#
+# Exit codes:
+#   0 - No regressions.
+#   1 - At least one scenario regressed.
+#   2 - A benchmark failed to run.
+#
+# Numbers are only comparable on the same host, so no baseline is
+# committed. Create one on the target hardware with --update before
+# the first comparison. The gate refuses to compare against a baseline
+# recorded on a different host unless --ignore-host is given.
+#
+
+import argparse
+import json
+import math
+import os
+import platform
+import shutil
+import signal
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+
+# (publishers, subscribers, payload size)
+QUEUE_SCENARIOS = [
+    (1, 1, 8),
+    (1, 1, 64),
+    (1, 10, 64),
+    (4, 4, 64),
+    (1, 1, 1024),
+]
+
+# (publishers, subscribers, payload size, write batch size, use poll)
+FUSE_SCENARIOS = [
+    (1, 1, 64, 1, False),
+    (1, 1, 64, 10, False),
+    (1, 10, 64, 10, False),
+    (1, 4, 64, 10, True),
+]
+
+# Keep the benchmarks and sigfs on separate CPUs when there are enough of them.
+DEFAULT_CPUS = "0-3" if (os.cpu_count() or 1) >= 8 else ""
+DEFAULT_SIGFS_CPUS = "4-7" if (os.cpu_count() or 1) >= 8 else ""
+
+# Baseline metrics.
+# name: (json key from the test program, higher is better)
+METRICS = {
+    "throughput": ("signals_per_sec", True),
+    "p99": ("latency_p99_nsec", False),
+}
+
+FUSE_CONFIG = """
+{
+  "root": {
+    "name": "/",
+    "uid_access": [ { "uid": %d, "access": [ "read", "write", "cascade" ] } ],
+    "entries": [ { "name": "gate", "queue_length": 1048576 } ]
+  }
+}
+"""
+
+
+class BenchmarkError(Exception):
+    pass
+
+
+def queue_name(pub, sub, payload):
+    return "queue: %d pub / %d sub / %d B payload" % (pub, sub, payload)
+
+
+def fuse_name(pub, sub, payload, batch, poll):
+    return "fuse: %d pub / %d sub / %d B payload / batch %d%s" % \
+        (pub, sub, payload, batch, " / poll" if poll else "")
+
+
+def run_json(cmd, cpus):
+    if cpus:
+        cmd = ["taskset", "-c", cpus] + cmd
+
+    res = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+
+    if res.returncode != 0:
+        raise BenchmarkError("%s failed with exit code %d: %s%s" %
+                             (" ".join(cmd), res.returncode, res.stdout, res.stderr))
+    try:
+        return json.loads(res.stdout.strip().splitlines()[-1])
+    except (ValueError, IndexError):
+        raise BenchmarkError("%s: could not parse output: %s" % (" ".join(cmd), res.stdout))
+
+
+class SigFS:
+    """A sigfs process serving the file 'gate' on a temporary mount point."""
+
+    def __init__(self, exe, cpus):
+        self.dir = tempfile.mkdtemp(prefix="sigfs-gate.")
+        self.root = os.path.join(self.dir, "root")
+        self.file = os.path.join(self.root, "gate")
+        config = os.path.join(self.dir, "sigfs.json")
+
+        os.mkdir(self.root)
+        with open(config, "w") as out:
+            out.write(FUSE_CONFIG % os.getuid())
+
+        cmd = [exe, "-f", "-c", config, self.root]
+        if cpus:
+            cmd = ["taskset", "-c", cpus] + cmd
+
+        self.proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+        for _ in range(500):
+            if os.path.exists(self.file):
+                return
+
+            if self.proc.poll() is not None:
+                self.stop()
+                raise BenchmarkError("%s exited with code %d before mounting %s" %
+                                     (exe, self.proc.returncode, self.root))
+            time.sleep(0.01)
+
+        self.stop()
+        raise BenchmarkError("Timed out waiting for %s to mount %s" % (exe, self.root))
+
+    def stop(self):
+        if self.proc.poll() is None:
+            # The FUSE signal handlers unmount the file system.
+            self.proc.send_signal(signal.SIGHUP)
+            self.proc.wait()
+
+        shutil.rmtree(self.dir, ignore_errors=True)
+
+
+def measure(args, cmd, name):
+    """Run cmd args.runs times and return the median and stddev of each metric."""
+    samples = {}
+
+    print("Running %s" % name, file=sys.stderr)
+    for _ in range(args.runs):
+        res = run_json(cmd, args.cpus)
+
+        for metric, (key, _) in METRICS.items():
+            if key in res:
+                samples.setdefault(metric, []).append(float(res[key]))
+
+    return {metric: {"median": statistics.median(values),
+                     "stddev": statistics.stdev(values) if len(values) > 1 else 0.0}
+            for metric, values in samples.items()}
+
+
+def run_scenarios(args):
+    results = {}
+
+    for (pub, sub, payload) in QUEUE_SCENARIOS:
+        cmd = [args.queue_speed, "--json",
+               "-p", str(pub), "-s", str(sub), "-P", str(payload),
+               "-c", str(args.count // pub), "-q", str(args.queue_length)]
+
+        results[queue_name(pub, sub, payload)] = measure(args, cmd, queue_name(pub, sub, payload))
+
+    if args.no_fuse:
+        return results
+
+    if not os.access(args.sigfs, os.X_OK):
+        print("%s not found. Skipping FUSE scenarios." % args.sigfs, file=sys.stderr)
+        return results
+
+    for (pub, sub, payload, batch, poll) in FUSE_SCENARIOS:
+        name = fuse_name(pub, sub, payload, batch, poll)
+        fs = SigFS(args.sigfs, args.sigfs_cpus)
+
+        try:
+            cmd = [args.fuse_test, "--json", "-f", fs.file, "-t", name,
+                   "-p", str(pub), "-s", str(sub), "-P", str(payload), "-b", str(batch),
+                   "-c", str(args.fuse_count // pub)]
+            if poll:
+                cmd.append("-u")
+
+            results[name] = measure(args, cmd, name)
+        finally:
+            fs.stop()
+
+    return results
+
+
+def noise(base, cur):
+    """Combined relative run to run noise of two measurements."""
+    def cv(m):
+        return m["stddev"] / m["median"] if m["median"] else 0.0
+
+    return 2.0 * math.sqrt(cv(base) ** 2 + cv(cur) ** 2)
+
+
+# Host properties that must match between the baseline and the
+# current run for the numbers to be comparable.
+HOST_KEYS = ["machine", "processor", "cpu_count", "cpus", "sigfs_cpus"]
+
+
+def host_info(args):
+    return {"machine": platform.machine(),
+            "processor": platform.processor(),
+            "cpu_count": os.cpu_count(),
+            "cpus": args.cpus,
+            "sigfs_cpus": args.sigfs_cpus,
+            "runs": args.runs}
+
+
+def host_mismatches(base_host, host):
+    """Host properties that differ from those of the baseline."""
+    return ["%s %r, baseline %r" % (key, host.get(key), base_host.get(key))
+            for key in HOST_KEYS if host.get(key) != base_host.get(key)]
+
+
+def compare(args, baseline, results):
+    regressions = 0
+
+    for name, metrics in results.items():
+        if name not in baseline:
+            print("%s: no baseline" % name)
+            continue
+
+        changes = []
+        regressed = []
+
+        for metric, (_, higher_is_better) in METRICS.items():
+            if metric not in metrics or metric not in baseline[name]:
+                continue
+
+            base = baseline[name][metric]
+            cur = metrics[metric]
+
+            if not base["median"]:
+                continue
+
+            change = (cur["median"] - base["median"]) / base["median"]
+            threshold = args.threshold if higher_is_better else args.latency_threshold
+            allowed = max(threshold / 100.0, noise(base, cur))
+            worse = -change if higher_is_better else change
+
+            label = "%+.0f%% %s" % (change * 100.0, metric) if higher_is_better else \
+                "%s %+.0f%%" % (metric, change * 100.0)
+
+            changes.append(label)
+            if worse > allowed:
+                regressed.append("%s worse than %.0f%%" % (metric, allowed * 100.0))
+
+        line = "%s: %s" % (name, ", ".join(changes))
+        if regressed:
+            regressions += 1
+            line += "  REGRESSION (%s)" % ", ".join(regressed)
+
+        print(line)
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="sigfs performance regression gate")
+    parser.add_argument("--baseline", default=os.path.join(SCRIPT_DIR, "sigfs_perf_baseline.json"),
+                        help="Baseline file. Default: %(default)s")
+    parser.add_argument("--update", action="store_true",
+                        help="Write the results to the baseline file instead of comparing.")
+    parser.add_argument("--ignore-host", action="store_true",
+                        help="Compare against a baseline recorded on a different host, with a warning.")
+    parser.add_argument("--runs", type=int, default=5,
+                        help="Runs per scenario. Default: %(default)s")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="Allowed throughput drop in percent. Default: %(default)s")
+    parser.add_argument("--latency-threshold", type=float, default=25.0,
+                        help="Allowed p99 latency increase in percent. Default: %(default)s")
+    parser.add_argument("--cpus", default=DEFAULT_CPUS,
+                        help="CPU list passed to taskset(1) for the benchmarks. "
+                        "Empty to disable pinning. Default: %(default)s")
+    parser.add_argument("--sigfs-cpus", default=DEFAULT_SIGFS_CPUS,
+                        help="CPU list passed to taskset(1) for sigfs. Default: %(default)s")
+    parser.add_argument("--count", type=int, default=200000,
+                        help="Signals per queue scenario run. Default: %(default)s")
+    parser.add_argument("--fuse-count", type=int, default=100000,
+                        help="Signals per FUSE scenario run. Default: %(default)s")
+    parser.add_argument("--queue-length", type=int, default=1048576,
+                        help="Queue length of the queue scenarios. Default: %(default)s")
+    parser.add_argument("--no-fuse", action="store_true",
+                        help="Skip the FUSE scenarios.")
+    parser.add_argument("--sigfs", default=os.path.join(SCRIPT_DIR, "..", "sigfs"))
+    parser.add_argument("--queue-speed", default=os.path.join(SCRIPT_DIR, "sigfs_test_queue_speed"))
+    parser.add_argument("--fuse-test", default=os.path.join(SCRIPT_DIR, "sigfs_test_fuse"))
+    args = parser.parse_args()
+
+    # Check the baseline before spending time on the benchmarks.
+    if not args.update:
+        try:
+            with open(args.baseline) as inp:
+                content = json.load(inp)
+                baseline = content["scenarios"]
+        except FileNotFoundError:
+            print("%s: No baseline. Create one on this host with --update first." % args.baseline,
+                  file=sys.stderr)
+            return 2
+        except (OSError, ValueError, KeyError) as err:
+            print("%s: %s" % (args.baseline, err), file=sys.stderr)
+            return 2
+
+        mismatches = host_mismatches(content.get("host", {}), host_info(args))
+
+        if mismatches:
+            print("%s: Recorded on a different host: %s" % (args.baseline, "; ".join(mismatches)),
+                  file=sys.stderr)
+
+            if not args.ignore_host:
+                print("Recreate the baseline on this host with --update, or compare anyway with --ignore-host.",
+                      file=sys.stderr)
+                return 2
+
+            print("Comparing anyway. Differences may be due to the host.", file=sys.stderr)
+
+    try:
+        results = run_scenarios(args)
+    except BenchmarkError as err:
+        print(err, file=sys.stderr)
+        return 2
+
+    if args.update:
+        with open(args.baseline, "w") as out:
+            json.dump({"host": host_info(args),
+                       "scenarios": results},
+                      out, indent=2)
+            out.write("\n")
+
+        print("Wrote %d scenarios to %s" % (len(results), args.baseline))
+        return 0
+
+    regressions = compare(args, baseline, results)
+
+    if regressions:
+        print("%d of %d scenarios regressed" % (regressions, len(results)))
+        return 1
+
+    print("No regressions in %d scenarios" % len(results))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -52,6 +52,7 @@ void usage(const char* name)
     puts("        [-b batch_size | --batch-size=batch_size]\n");
     puts("        [-t test_name | --test-name=test-name]\n");
     puts("        [-u | --use-poll]\n");
+    puts("        [-j | --json]\n");
     puts("-p number-of-publishers   How many parallel publisher threads to we start. Default: 1");
     puts("-s number-of-subscribers  How many parallel subscribers threads to we start. Default: 1");
     puts("-P payload-size           Number of bytes to send in each signal. Min: 8. Default: 8");
@@ -59,6 +60,7 @@ void usage(const char* name)
     puts("-b batch-size             How many signals do each publisher pack into a single write operation. Default: 1");
     puts("-t test-name              Label to print on test pass or fail. Default: \"unnamed test\"");
     puts("-u                        Use poll(2) to wait for a signal before reading it.");
+    puts("-j                        Print the result as a single JSON object instead of \"passed\".");
 }
 
 #ifdef SIGFS_LOG
@@ -541,6 +543,7 @@ int main(int argc,  char *const* argv)
         {"test-name", optional_argument, NULL, 't'},
         {"payload-size", optional_argument, NULL, 'P'},
         {"use-poll", optional_argument, NULL, 'u'},
+        {"json", no_argument, NULL, 'j'},
         {NULL, 0, NULL, 0}
     };
 
@@ -551,12 +554,13 @@ int main(int argc,  char *const* argv)
     char filename[256] = {};
     size_t payload_size{8};
     bool use_poll{false};
+    bool json{false};
 
     prog_name = argv[0];
 
     strcpy(test_name, "unnamed test");
     // loop over all of the options
-    while ((ch = getopt_long(argc, argv, "p:s:c:f:b:P:t:u", long_options, NULL)) != -1) {
+    while ((ch = getopt_long(argc, argv, "p:s:c:f:b:P:t:uj", long_options, NULL)) != -1) {
         // check to see if a single character or long option came through
         switch (ch)
         {
@@ -586,6 +590,10 @@ int main(int argc,  char *const* argv)
             use_poll = true;
             break;
 
+        case 'j':
+            json = true;
+            break;
+
         case 'b':
             batch_size = std::atoi(optarg);
             break;
@@ -626,6 +634,7 @@ int main(int argc,  char *const* argv)
     //
     // Are the readers going to get  their own thread or used poll mode?
     //
+    int reader_count = subscriber_count;
     if (!use_poll) {
         for (int i=0; i < subscriber_count; ++i) {
             sub_thr[i] = std::make_unique<std::thread>(check_signal_sequence_thread,
@@ -662,9 +671,7 @@ int main(int argc,  char *const* argv)
         sub_thr[i]->join();
     }
 
-#ifdef SIGFS_LOG
     auto done = sigfs_usec_since_start();
-#endif
 
     SIGFS_LOG_INFO("nr-publishers: %d, nr-subscribers: %d, total-signal-count: %d",
                    publisher_count,
@@ -689,6 +696,16 @@ int main(int argc,  char *const* argv)
     //        (float) done*1000 / (float) (signal_count*publisher_count));
 
 
+    if (json) {
+        printf("{ \"test\": \"fuse\", \"name\": \"%s\", \"publishers\": %d, \"subscribers\": %d, "
+               "\"payload_size\": %lu, \"batch_size\": %d, \"use_poll\": %s, \"signals\": %d, "
+               "\"elapsed_usec\": %ld, \"signals_per_sec\": %.0f }\n",
+               test_name, publisher_count, reader_count, payload_size, batch_size, use_poll?"true":"false",
+               signal_count * publisher_count, done,
+               (float) (signal_count*publisher_count) / (float) (done / 1000000.0));
+        exit(0);
+    }
+
     printf("%s: sigfs filesystem test - passed\n", prog_name);
     exit(0);
 }
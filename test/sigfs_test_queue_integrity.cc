@@ -27,6 +27,9 @@
 #include <sys/resource.h>
 
 #include "../queue_impl.hh"
+#include "../crc32c.hh"
+#include "../aggregate.hh"
+#include "../merge.hh"
 void usage(const char* name)
 {
     std::cout << "Usage: " << name << " -d <data> | --data=<data>" << std::endl;
@@ -62,7 +65,8 @@ void check_signal(sigfs::Queue& queue,
          const char* payload,
          std::uint32_t payload_size,
          signal_count_t lost_signals,
-         signal_count_t remaining_signal_count) -> sigfs::Queue::cb_result_t {
+         signal_count_t remaining_signal_count,
+             std::uint64_t publish_time) -> sigfs::Queue::cb_result_t {
             if (!payload) {
                 SIGFS_LOG_FATAL("%s: Wanted %lu bytes. Got interrupted!", prefix, wanted_res);
                 queue.dump(prefix, sub);
@@ -131,7 +135,8 @@ void check_signal_sequence(const char* test_id,
              const char* payload,
              std::uint32_t payload_size,
              signal_count_t lost_signals,
-             signal_count_t remaining_signal_count) -> sigfs::Queue::cb_result_t {
+             signal_count_t remaining_signal_count,
+             std::uint64_t publish_time) -> sigfs::Queue::cb_result_t {
 
                 int prefix_ind{0};
                 (void) x;
@@ -261,6 +266,10 @@ void publish_signal_sequence(const char* test_id, sigfs::Queue& queue, const int
                         publish_id, sig_id);
 
         queue.queue_signal(buf, 2*sizeof(int));
+
+        // Let subscribers run. On a single CPU, a publisher would
+        // otherwise wrap the queue before a subscriber is scheduled.
+        std::this_thread::yield();
     }
     SIGFS_LOG_DEBUG("%s: Done. Published %d signals", test_id, count);
 }
@@ -470,6 +479,904 @@ int main(int argc,  char *const* argv)
         }
     }
 
+    {
+        // TEST 1.6
+        // Queue statistics
+        //
+        SIGFS_LOG_DEBUG("START: 1.6");
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(4));
+        Subscriber sub1(g_queue);
+        Subscriber sub2(g_queue);
+        Subscriber publisher(g_queue, false);
+
+        g_queue->queue_signal("SIG001", 7);
+        g_queue->queue_signal("SIG002", 7);
+        check_signal(*g_queue, "1.6.1", sub1, "SIG001", 7, 0);
+
+        auto stats = g_queue->statistics();
+        assert(stats.queue_length == 4);
+        assert(stats.signals_published == 2);
+        assert(stats.bytes_published == 14);
+        assert(stats.signals_lost == 0);
+        assert(stats.subscribers.size() == 2); // Publisher is not included.
+
+        for(auto& sub_stats: stats.subscribers) {
+            if (sub_stats.sub_id == sub1.sub_id()) {
+                assert(sub_stats.signals_delivered == 1);
+                assert(sub_stats.lag == 1);
+            } else {
+                assert(sub_stats.sub_id == sub2.sub_id());
+                assert(sub_stats.signals_delivered == 0);
+                assert(sub_stats.lag == 2);
+            }
+        }
+
+        // Overwrap the queue so that sub2 loses two signals.
+        g_queue->queue_signal("SIG003", 7);
+        g_queue->queue_signal("SIG004", 7);
+        g_queue->queue_signal("SIG005", 7);
+        check_signal(*g_queue, "1.6.2", sub2, "SIG003", 7, 2);
+
+        stats = g_queue->statistics();
+        assert(stats.signals_published == 5);
+        assert(stats.signals_lost == 2);
+        assert(stats.peak_occupancy == 3);
+        assert(sub2.signals_lost() == 2);
+        assert(sub1.signals_lost() == 0);
+        SIGFS_LOG_INFO("PASS: 1.6");
+    }
+
+    {
+        // TEST 1.7
+        // Publish timestamps and latency histogram
+        //
+        SIGFS_LOG_DEBUG("START: 1.7");
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(4));
+        Subscriber sub1(g_queue);
+        std::uint64_t before(Queue::timestamp());
+        std::uint64_t stamps[2] = {};
+        int ind = 0;
+
+        g_queue->queue_signal("SIG001", 7);
+        g_queue->queue_signal("SIG002", 7);
+
+        Queue::signal_callback_t<void*> cb =
+            [&stamps, &ind](void* userdata,
+                            signal_id_t signal_id,
+                            const char* payload,
+                            std::uint32_t payload_size,
+                            signal_count_t lost_signals,
+                            signal_count_t remaining_signal_count,
+                            std::uint64_t publish_time) -> Queue::cb_result_t {
+                stamps[ind++] = publish_time;
+                return Queue::cb_result_t::processed_call_again;
+            };
+
+        g_queue->dequeue_signal<void*>(sub1, 0, cb);
+        assert(ind == 2);
+        assert(stamps[0] >= before);
+        assert(stamps[1] >= stamps[0]);
+        assert(stamps[1] <= Queue::timestamp());
+
+        // Every value below 32 has its own bucket, above that
+        // values are reported with ~3% precision.
+        Histogram& hist(g_queue->delivery_latency());
+        for(std::uint64_t val = 1; val <= 1000; ++val)
+            hist.record(val * 1000);
+
+        auto stats = g_queue->statistics();
+        assert(stats.latency.count == 1000);
+        assert(stats.latency.max == 1000000);
+        assert(stats.latency.mean == 500500);
+        assert(stats.latency.p50 >= 500000 && stats.latency.p50 <= 500000 * 1.04);
+        assert(stats.latency.p99 >= 990000 && stats.latency.p99 <= 990000 * 1.04);
+        assert(stats.latency.p999 >= 999000 && stats.latency.p999 <= 1000000);
+
+        hist.reset();
+        hist.record(17);
+        assert(hist.count() == 1);
+        assert(hist.percentile(50.0) == 17);
+        assert(hist.percentile(99.9) == 17);
+        SIGFS_LOG_INFO("PASS: 1.7");
+    }
+
+    {
+        // TEST 1.8
+        // Batch dequeue
+        //
+        SIGFS_LOG_DEBUG("START: 1.8");
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(8));
+        Subscriber sub1(g_queue);
+        signal_id_t first_id(sub1.sig_id());
+
+        g_queue->queue_signal("SIG001", 7);
+        g_queue->queue_signal("SIG002", 7);
+        g_queue->queue_signal("SIG003", 7);
+
+        // Consume two out of a batch of three.
+        g_queue->dequeue_signals(sub1, 4,
+                                 [first_id](const Queue::SignalBatch& batch) -> std::size_t {
+                                     assert(batch.size() == 3);
+                                     assert(batch.lost_signals() == 0);
+                                     assert(batch.remaining_signal_count() == 0);
+                                     assert(batch[0].signal_id == first_id);
+                                     assert(batch[2].signal_id == first_id + 2);
+                                     assert(batch[1].payload_size == 7);
+                                     assert(!strcmp(batch[1].payload, "SIG002"));
+                                     assert(batch[1].publish_time >= batch[0].publish_time);
+                                     return 2;
+                                 });
+
+        assert(sub1.sig_id() == first_id + 2);
+
+        // Batch size is capped by max_count.
+        g_queue->queue_signal("SIG004", 7);
+        g_queue->queue_signal("SIG005", 7);
+        g_queue->dequeue_signals(sub1, 2,
+                                 [first_id](const Queue::SignalBatch& batch) -> std::size_t {
+                                     assert(batch.size() == 2);
+                                     assert(batch.remaining_signal_count() == 1);
+                                     assert(!strcmp(batch[0].payload, "SIG003"));
+                                     assert(!strcmp(batch[1].payload, "SIG004"));
+                                     return batch.size();
+                                 });
+
+        assert(sub1.sig_id() == first_id + 4);
+
+        // Overflow the queue and check that the loss is reported
+        // ahead of the oldest remaining signal.
+        for(int ind = 0; ind < 16; ++ind)
+            g_queue->queue_signal("SIGXXX", 7);
+
+        g_queue->dequeue_signals(sub1, Queue::SignalBatch::max_size,
+                                 [first_id](const Queue::SignalBatch& batch) -> std::size_t {
+                                     assert(batch.lost_signals() > 0);
+                                     assert(batch[0].signal_id == first_id + 4 + batch.lost_signals());
+                                     assert(batch.remaining_signal_count() == 0);
+                                     assert(batch[batch.size() - 1].signal_id == first_id + 20);
+                                     return batch.size();
+                                 });
+
+        SIGFS_LOG_INFO("PASS: 1.8");
+    }
+
+    {
+        // TEST 1.9
+        // Every sync and storage policy combination. Use a large
+        // payload and a small arena slot size to have payloads move
+        // between the slots and the heap.
+        //
+        SIGFS_LOG_DEBUG("START: 1.9");
+        static const char* large_payload = "SIG-LARGE-PAYLOAD-0123456789-0123456789";
+
+        for(auto sync: { Queue::Config::sync_t::mutex, Queue::Config::sync_t::spin })
+            for(auto storage: { Queue::Config::storage_t::heap,
+                                 Queue::Config::storage_t::arena,
+                                 Queue::Config::storage_t::inline_slot }) {
+                Queue::Config cfg;
+
+                cfg.sync = sync;
+                cfg.storage = storage;
+                cfg.slot_size = 8;
+
+                // Exercise the huge page, mlock and NUMA paths as well.
+                if (sync == Queue::Config::sync_t::spin && storage != Queue::Config::storage_t::heap) {
+                    cfg.memory.huge_pages = true;
+                    cfg.memory.lock = true;
+                    cfg.memory.numa_node = 0;
+                }
+
+                std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(4, 0, cfg));
+                Subscriber sub1(g_queue);
+
+                assert(g_queue->config().sync == sync);
+                assert(g_queue->config().storage == storage);
+
+                g_queue->queue_signal("SIG001", 7);
+                g_queue->queue_signal(large_payload, strlen(large_payload) + 1);
+                check_signal(*g_queue, "1.9.1", sub1, "SIG001", 7, 0);
+                check_signal(*g_queue, "1.9.2", sub1, large_payload, strlen(large_payload) + 1, 0);
+
+                // Wrap the queue so that the slot that held the large
+                // payload gets a small one. Only the last three
+                // signals will be available.
+                g_queue->queue_signal("SIG003", 7);
+                g_queue->queue_signal("SIG004", 7);
+                g_queue->queue_signal("SIG005", 7);
+                g_queue->queue_signal("SIG006", 7);
+                g_queue->queue_signal("SIG007", 7);
+                g_queue->queue_signal("SIG008", 7);
+                check_signal(*g_queue, "1.9.3", sub1, "SIG006", 7, 3);
+                check_signal(*g_queue, "1.9.4", sub1, "SIG007", 7, 0);
+                check_signal(*g_queue, "1.9.5", sub1, "SIG008", 7, 0);
+                assert(!g_queue->signal_available(sub1));
+            }
+
+        SIGFS_LOG_INFO("PASS: 1.9");
+    }
+
+    {
+        // TEST 1.10
+        // Subscriber filters.
+        //
+        SIGFS_LOG_DEBUG("START: 1.10");
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(16));
+        Subscriber sub1(g_queue);
+        sigfs_filter_t filter_arg;
+        SignalFilter filter;
+
+        // Only signals starting with 'A'. Bits beyond the predicate
+        // size are dropped from mask.
+        memset(&filter_arg, 0, sizeof(filter_arg));
+        filter_arg.predicate_count = 1;
+        filter_arg.predicates[0].size = 1;
+        filter_arg.predicates[0].mask = 0xFFFF;
+        filter_arg.predicates[0].value = 'A';
+        assert(filter.set(filter_arg));
+        g_queue->set_filter(sub1, filter);
+
+        sub1.filter().get(filter_arg);
+        assert(filter_arg.predicate_count == 1);
+        assert(filter_arg.predicates[0].mask == 0xFF);
+
+        g_queue->queue_signal("A01", 4);
+        g_queue->queue_signal("B02", 4);
+        g_queue->queue_signal("B03", 4);
+        g_queue->queue_signal("A04", 4);
+        g_queue->queue_signal("B05", 4);
+        check_signal(*g_queue, "1.10.1", sub1, "A01", 4, 0);
+        check_signal(*g_queue, "1.10.2", sub1, "A04", 4, 0);
+
+        // B05 is ready, but does not pass the filter.
+        assert(!g_queue->signal_available(sub1));
+
+        // Batches skip filtered signals as well.
+        g_queue->queue_signal("A06", 4);
+        g_queue->queue_signal("B07", 4);
+        g_queue->queue_signal("A08", 4);
+        g_queue->dequeue_signals(sub1, Queue::SignalBatch::max_size,
+                                 [](const Queue::SignalBatch& batch) -> std::size_t {
+                                     assert(batch.size() == 2);
+                                     assert(batch.lost_signals() == 0);
+                                     assert(!strcmp(batch[0].payload, "A06"));
+                                     assert(!strcmp(batch[1].payload, "A08"));
+                                     assert(batch[1].signal_id == batch[0].signal_id + 2);
+                                     return batch.size();
+                                 });
+
+        assert(sub1.signals_filtered() == 4);
+
+        // Lost signals are reported with the next signal passing
+        // the filter. 21 signals in a queue holding 15 loses 6.
+        for(int ind = 0; ind < 20; ++ind)
+            g_queue->queue_signal("B09", 4);
+
+        g_queue->queue_signal("A10", 4);
+        check_signal(*g_queue, "1.10.3", sub1, "A10", 4, 6);
+        assert(sub1.signals_filtered() == 4 + 14);
+        assert(sub1.signals_lost() == 6);
+        assert(g_queue->statistics().subscribers[0].signals_filtered == 4 + 14);
+
+        // Predicates of more than one byte and more than one predicate.
+        memset(&filter_arg, 0, sizeof(filter_arg));
+        filter_arg.predicate_count = 2;
+        filter_arg.predicates[0].size = 2;
+        filter_arg.predicates[0].mask = 0xFFFF;
+        filter_arg.predicates[0].value = 'C' | ('1' << 8);
+        filter_arg.predicates[1].offset = 4;
+        filter_arg.predicates[1].size = 8;
+        filter_arg.predicates[1].mask = ~0ULL;
+        filter_arg.predicates[1].value = 0x0807060504030201ULL;
+        assert(filter.set(filter_arg));
+        g_queue->set_filter(sub1, filter);
+
+        g_queue->queue_signal("C1\0\0\x01\x02\x03\x04\x05\x06\x07\x09", 12);
+        g_queue->queue_signal("C2\0\0\x01\x02\x03\x04\x05\x06\x07\x08", 12);
+        g_queue->queue_signal("C1\0\0\x01\x02\x03\x04\x05\x06\x07", 11);
+        g_queue->queue_signal("C1\0\0\x01\x02\x03\x04\x05\x06\x07\x08", 12);
+        check_signal(*g_queue, "1.10.4", sub1, "C1\0\0\x01\x02\x03\x04\x05\x06\x07\x08", 12, 0);
+
+        // Invalid filters are rejected.
+        filter_arg.predicates[1].size = 9;
+        assert(!filter.set(filter_arg));
+        filter_arg.predicates[1].size = 0;
+        assert(!filter.set(filter_arg));
+        filter_arg.predicates[1].size = 8;
+        filter_arg.predicate_count = SIGFS_FILTER_MAX_PREDICATES + 1;
+        assert(!filter.set(filter_arg));
+
+        // An empty filter delivers all signals.
+        memset(&filter_arg, 0, sizeof(filter_arg));
+        assert(filter.set(filter_arg));
+        g_queue->set_filter(sub1, filter);
+        g_queue->queue_signal("B11", 4);
+        check_signal(*g_queue, "1.10.5", sub1, "B11", 4, 0);
+
+        SIGFS_LOG_INFO("PASS: 1.10");
+    }
+
+    {
+        // TEST 1.11
+        // Subscriber rate limits.
+        //
+        SIGFS_LOG_DEBUG("START: 1.11");
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(64));
+        Subscriber sub1(g_queue);
+        sigfs_rate_t rate_arg;
+        DeliveryRate rate;
+        char buf[16];
+
+        // Every third signal.
+        memset(&rate_arg, 0, sizeof(rate_arg));
+        rate_arg.decimation = 3;
+        assert(rate.set(rate_arg));
+        g_queue->set_rate(sub1, rate);
+
+        for(int ind = 0; ind < 10; ++ind) {
+            sprintf(buf, "S%.2d", ind);
+            g_queue->queue_signal(buf, 4);
+        }
+
+        // Process two of S00, S03, S06, S09.
+        g_queue->dequeue_signals(sub1, Queue::SignalBatch::max_size,
+                                 [](const Queue::SignalBatch& batch) -> std::size_t {
+                                     assert(batch.size() == 4);
+                                     assert(!strcmp(batch[0].payload, "S00"));
+                                     assert(!strcmp(batch[1].payload, "S03"));
+                                     assert(!strcmp(batch[2].payload, "S06"));
+                                     assert(!strcmp(batch[3].payload, "S09"));
+                                     assert(batch[0].signals_skipped == 0);
+                                     assert(batch[1].signals_skipped == 2);
+                                     assert(batch[3].signals_skipped == 2);
+                                     assert(batch.lost_signals() == 0);
+                                     return 2;
+                                 });
+
+        assert(sub1.signals_skipped() == 4);
+
+        g_queue->dequeue_signals(sub1, Queue::SignalBatch::max_size,
+                                 [](const Queue::SignalBatch& batch) -> std::size_t {
+                                     assert(batch.size() == 2);
+                                     assert(!strcmp(batch[0].payload, "S06"));
+                                     assert(!strcmp(batch[1].payload, "S09"));
+                                     return batch.size();
+                                 });
+
+        assert(sub1.signals_skipped() == 6);
+        assert(sub1.signals_delivered() == 4);
+
+        // S12 is the next one to deliver.
+        for(int ind = 10; ind < 15; ++ind) {
+            sprintf(buf, "S%.2d", ind);
+            g_queue->queue_signal(buf, 4);
+        }
+        check_signal(*g_queue, "1.11.1", sub1, "S12", 4, 0);
+        assert(!g_queue->signal_available(sub1));
+        assert(sub1.signals_skipped() == 8);
+
+        // Deliver the newest signal, at most once per 20 msec.
+        memset(&rate_arg, 0, sizeof(rate_arg));
+        rate_arg.min_interval_nsec = 20000000;
+        assert(rate.set(rate_arg));
+        g_queue->set_rate(sub1, rate);
+
+        g_queue->queue_signal("T01", 4);
+        g_queue->queue_signal("T02", 4);
+        g_queue->queue_signal("T03", 4);
+        g_queue->dequeue_signals(sub1, Queue::SignalBatch::max_size,
+                                 [](const Queue::SignalBatch& batch) -> std::size_t {
+                                     assert(batch.size() == 1);
+                                     assert(!strcmp(batch[0].payload, "T03"));
+
+                                     // S13 and S14 as well.
+                                     assert(batch[0].signals_skipped == 4);
+                                     return batch.size();
+                                 });
+
+        // Too soon after T03. Held back until the interval is up,
+        // and then delivered without another signal being published.
+        g_queue->queue_signal("T04", 4);
+        assert(!g_queue->signal_available(sub1));
+        assert(g_queue->signal_held_until(sub1) > Queue::timestamp());
+
+        const std::uint64_t held_until(g_queue->signal_held_until(sub1));
+
+        g_queue->dequeue_signals(sub1, Queue::SignalBatch::max_size,
+                                 [](const Queue::SignalBatch& batch) -> std::size_t {
+                                     assert(batch.size() == 1);
+                                     assert(!strcmp(batch[0].payload, "T04"));
+                                     assert(batch[0].signals_skipped == 0);
+                                     return batch.size();
+                                 });
+        assert(Queue::timestamp() >= held_until);
+
+        // T06 replaces T05 while held back.
+        g_queue->queue_signal("T05", 4);
+        g_queue->queue_signal("T06", 4);
+        assert(!g_queue->signal_available(sub1));
+
+        usleep(25000);
+        assert(g_queue->signal_available(sub1));
+        assert(!g_queue->signal_held_until(sub1));
+        check_signal(*g_queue, "1.11.2", sub1, "T06", 4, 0);
+
+        assert(g_queue->statistics().subscribers[0].signals_skipped == 8 + 4 + 1);
+
+        sub1.rate().get(rate_arg);
+        assert(rate_arg.min_interval_nsec == 20000000);
+        assert(rate_arg.decimation == 0);
+
+        rate_arg.reserved = 1;
+        assert(!rate.set(rate_arg));
+
+        SIGFS_LOG_INFO("PASS: 1.11");
+    }
+
+    {
+        // TEST 1.12
+        // Change-only delivery. Repeated payloads are dropped.
+        //
+        SIGFS_LOG_DEBUG("START: 1.12");
+        static const char* long_payload = "STATE-0123456789-0123456789-0123456789-A";
+        Queue::Config cfg;
+
+        cfg.on_change = true;
+
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(16, 0, cfg));
+        Subscriber sub1(g_queue);
+
+        g_queue->queue_signal("ON", 3);
+        g_queue->queue_signal("ON", 3);
+        g_queue->queue_signal("ON", 3);
+        g_queue->queue_signal("OFF", 4);
+        g_queue->queue_signal("OFF", 4);
+        g_queue->queue_signal("ON", 3);
+
+        // Same prefix, different size.
+        g_queue->queue_signal("ON", 2);
+        g_queue->queue_signal(long_payload, strlen(long_payload) + 1);
+        g_queue->queue_signal(long_payload, strlen(long_payload) + 1);
+
+        check_signal(*g_queue, "1.12.1", sub1, "ON", 3, 0);
+        check_signal(*g_queue, "1.12.2", sub1, "OFF", 4, 0);
+        check_signal(*g_queue, "1.12.3", sub1, "ON", 3, 0);
+        check_signal(*g_queue, "1.12.4", sub1, "ON", 2, 0);
+        check_signal(*g_queue, "1.12.5", sub1, long_payload, strlen(long_payload) + 1, 0);
+        assert(!g_queue->signal_available(sub1));
+
+        const Queue::Stats stats(g_queue->statistics());
+
+        assert(stats.signals_published == 5);
+        assert(stats.signals_suppressed == 4);
+
+        // Check the checksum against the CRC32C check value.
+        assert(crc32c("123456789", 9) == 0xE3069283);
+
+        SIGFS_LOG_INFO("PASS: 1.12");
+    }
+
+    {
+        // TEST 1.13
+        // Windowed aggregation into a derived queue.
+        //
+        SIGFS_LOG_DEBUG("START: 1.13");
+        static const std::uint64_t window = 100000000;
+        std::shared_ptr<Queue> source(std::make_shared<Queue>(16));
+        std::shared_ptr<Queue> target(std::make_shared<Queue>(16));
+        Subscriber sub1(target);
+        Aggregator::Config cfg;
+        char payload[12];
+
+        assert(Aggregator::Config::parse_function("max", cfg.function));
+        assert(Aggregator::Config::parse_type("int32", cfg.type));
+        assert(!Aggregator::Config::parse_type("int128", cfg.type));
+        cfg.window = window;
+        cfg.offset = 4;
+
+        Aggregator aggregator(cfg, target);
+
+        // Window 10: 3, -7, 5. Window 11: 2. Window 13: 1.
+        auto add =
+            [&aggregator, &payload](std::int32_t value, std::uint64_t timestamp) {
+                memset(payload, 0, sizeof(payload));
+                memcpy(payload + 4, &value, sizeof(value));
+                aggregator.add(payload, sizeof(payload), timestamp);
+            };
+
+        add(3, 10 * window);
+        add(-7, 10 * window + 1);
+        aggregator.add(payload, 7, 10 * window + 2); // Too short. Ignored.
+        add(5, 11 * window - 1);
+        assert(!target->signal_available(sub1));
+        add(2, 11 * window + 50);
+        add(1, 13 * window);
+
+        auto check_aggregate =
+            [&target, &sub1](std::uint64_t window_start, std::uint32_t count, double value) {
+                target->dequeue_signal(sub1,
+                                       [=](signal_id_t signal_id,
+                                           const char* payload,
+                                           std::uint32_t payload_size,
+                                           signal_count_t lost_signals,
+                                           signal_count_t remaining_signal_count,
+                                           std::uint64_t publish_time) -> Queue::cb_result_t {
+                                           sigfs_aggregate_t res;
+
+                                           assert(payload_size == sizeof(res));
+                                           memcpy(&res, payload, sizeof(res));
+                                           assert(res.window_start == window_start || window_start == ~0ULL);
+                                           assert(res.count == count);
+                                           assert(res.value == value);
+                                           return Queue::cb_result_t::processed_dont_call_again;
+                                       });
+            };
+
+        check_aggregate(10 * window, 3, 5.0);
+        check_aggregate(11 * window, 1, 2.0);
+        assert(!target->signal_available(sub1));
+
+        // Flush window 13 by aggregating a signal in the next one.
+        add(4, 14 * window);
+        check_aggregate(13 * window, 1, 1.0);
+        assert(!target->signal_available(sub1));
+
+        // Signals queued on the source are aggregated. Use a one
+        // hour window to have all signals end up in the same one.
+        Aggregator::Config mean_cfg;
+        mean_cfg.window = 3600 * 1000000000ULL;
+
+        auto mean(std::make_shared<Aggregator>(mean_cfg, target));
+        double value(0.0);
+
+        source->add_aggregator(mean);
+
+        for(double sample: { 1.0, 2.0, 6.0 })
+            source->queue_signal((const char*) &sample, sizeof(sample));
+
+        assert(!target->signal_available(sub1));
+        mean->add((const char*) &value, sizeof(value), Queue::timestamp() + mean_cfg.window);
+        check_aggregate(~0ULL, 3, 3.0);
+        assert(!target->signal_available(sub1));
+
+        SIGFS_LOG_INFO("PASS: 1.13");
+    }
+
+    {
+        // TEST 1.14
+        // Merge three queues in publish order.
+        //
+        SIGFS_LOG_DEBUG("START: 1.14");
+        std::shared_ptr<Queue> queues[3] = {
+            std::make_shared<Queue>(4),
+            std::make_shared<Queue>(4),
+            std::make_shared<Queue>(4)
+        };
+        MergedSubscriber merged({ { queues[0], 100 }, { queues[1], 101 }, { queues[2], 102 } });
+        std::string res;
+        std::size_t max_count(0);
+
+        auto cb =
+            [&merged, &res, &max_count](std::size_t source,
+                                        signal_id_t signal_id,
+                                        const char* payload,
+                                        std::uint32_t payload_size,
+                                        signal_count_t lost_signals,
+                                        std::uint64_t publish_time) -> Queue::cb_result_t {
+                if (!max_count)
+                    return Queue::cb_result_t::not_processed;
+
+                --max_count;
+                res += std::to_string(merged.source_id(source)) + ":" +
+                    std::string(payload, payload_size) + "/" + std::to_string(lost_signals) + " ";
+                return Queue::cb_result_t::processed_call_again;
+            };
+
+        assert(!merged.signal_available());
+
+        for(auto& [queue, payload]: std::initializer_list<std::pair<int, const char*>> {
+                { 0, "a1" }, { 1, "b1" }, { 0, "a2" }, { 2, "c1" }, { 1, "b2" }, { 0, "a3" } })
+            queues[queue]->queue_signal(payload, strlen(payload));
+
+        assert(merged.signal_available());
+
+        max_count = 4;
+        assert(merged.dequeue_signals(cb));
+        assert(res == "100:a1/0 101:b1/0 100:a2/0 102:c1/0 ");
+
+        res.clear();
+        max_count = 100;
+        assert(merged.dequeue_signals(cb));
+        assert(res == "101:b2/0 100:a3/0 ");
+        assert(!merged.signal_available());
+
+        // Overrun the first queue. Losses are reported per source.
+        for(auto payload: { "a4", "a5", "a6", "a7", "a8" })
+            queues[0]->queue_signal(payload, strlen(payload));
+
+        queues[2]->queue_signal("c2", 2);
+
+        res.clear();
+        assert(merged.dequeue_signals(cb));
+        assert(res == "100:a6/2 100:a7/0 100:a8/0 102:c2/0 ");
+
+        // A pending interrupt is delivered by the next call.
+        merged.interrupt_dequeue();
+        assert(!merged.dequeue_signals(cb));
+
+        // A blocked call is woken up by a publish to any source.
+        res.clear();
+        std::thread publisher([&queues] {
+            usleep(10000);
+            queues[1]->queue_signal("b3", 2);
+        });
+
+        assert(merged.dequeue_signals(cb));
+        publisher.join();
+        assert(res == "101:b3/0 ");
+
+        SIGFS_LOG_INFO("PASS: 1.14");
+    }
+
+    {
+        // TEST 1.15
+        // Move a subscriber to signals published before it was created.
+        //
+        SIGFS_LOG_DEBUG("START: 1.15");
+        std::shared_ptr<Queue> queue(std::make_shared<Queue>(8));
+        signal_count_t lost(0);
+
+        for(int ind = 1; ind <= 5; ++ind)
+            queue->queue_signal((const char*) &ind, sizeof(ind));
+
+        Subscriber sub1(queue);
+        auto check_next =
+            [&queue, &sub1](signal_id_t wanted_id, signal_count_t wanted_lost) {
+                assert(queue->dequeue_signal(sub1,
+                                            [=](signal_id_t signal_id,
+                                                const char* payload,
+                                                std::uint32_t payload_size,
+                                                signal_count_t lost_signals,
+                                                signal_count_t remaining_signal_count,
+                                                std::uint64_t publish_time) -> Queue::cb_result_t {
+                                                int value;
+
+                                                memcpy(&value, payload, sizeof(value));
+                                                assert(signal_id == wanted_id);
+                                                assert((signal_id_t) value == wanted_id);
+                                                assert(lost_signals == wanted_lost);
+                                                return Queue::cb_result_t::processed_dont_call_again;
+                                            }));
+            };
+
+        assert(!queue->signal_available(sub1));
+        assert(queue->seek(sub1, Queue::seek_t::oldest, 0, lost) == 1 && lost == 0);
+        check_next(1, 0);
+        check_next(2, 0);
+
+        assert(queue->seek(sub1, Queue::seek_t::signal_id, 4, lost) == 4 && lost == 0);
+        check_next(4, 0);
+
+        assert(queue->seek(sub1, Queue::seek_t::newest, 2, lost) == 4 && lost == 0);
+        check_next(4, 0);
+        check_next(5, 0);
+        assert(!queue->signal_available(sub1));
+
+        // Overwrite signals 1-8. Signals 9-15 are left.
+        for(int ind = 6; ind <= 15; ++ind)
+            queue->queue_signal((const char*) &ind, sizeof(ind));
+
+        assert(queue->seek(sub1, Queue::seek_t::signal_id, 3, lost) == 9 && lost == 6);
+        check_next(9, 0);
+
+        // There is no signal 0 to report as lost.
+        assert(queue->seek(sub1, Queue::seek_t::signal_id, 0, lost) == 9 && lost == 0);
+        check_next(9, 0);
+
+        assert(queue->seek(sub1, Queue::seek_t::newest, 100, lost) == 9 && lost == 8);
+        check_next(9, 0);
+
+        assert(queue->seek(sub1, Queue::seek_t::newest, 1, lost) == 15 && lost == 0);
+        check_next(15, 0);
+
+        assert(queue->seek(sub1, Queue::seek_t::signal_id, 100, lost) == 16 && lost == 0);
+        assert(!queue->signal_available(sub1));
+        assert(queue->seek(sub1, Queue::seek_t::newest, 0, lost) == 16 && lost == 0);
+        assert(!queue->signal_available(sub1));
+
+        SIGFS_LOG_INFO("PASS: 1.15");
+    }
+
+    {
+        // TEST 1.16
+        // Skip to the newest signals once a subscriber lags behind.
+        //
+        SIGFS_LOG_DEBUG("START: 1.16");
+        std::shared_ptr<Queue> queue(std::make_shared<Queue>(16));
+        Subscriber sub1(queue);
+        LagPolicy lag;
+
+        assert(!lag.set(sigfs_lag_t { .max_lag = 4, .keep = 0 }));
+        assert(!lag.set(sigfs_lag_t { .max_lag = 4, .keep = 5 }));
+        assert(lag.set(sigfs_lag_t { .max_lag = 4, .keep = 2 }));
+        queue->set_lag(sub1, lag);
+
+        for(auto payload: { "L1", "L2", "L3" })
+            queue->queue_signal(payload, 3);
+
+        // Within max_lag. Read all.
+        check_signal(*queue, "1.16.1", sub1, "L1", 3, 0);
+
+        for(auto payload: { "L4", "L5", "L6", "L7", "L8" })
+            queue->queue_signal(payload, 3);
+
+        // Seven signals behind. Skip to the two newest ones.
+        check_signal(*queue, "1.16.2", sub1, "L7", 3, 0);
+        check_signal(*queue, "1.16.3", sub1, "L8", 3, 0);
+        assert(sub1.signals_skipped() == 5);
+        assert(!queue->signal_available(sub1));
+
+        for(int ind = 0; ind < 10; ++ind)
+            queue->queue_signal("L9", 3);
+
+        queue->dequeue_signals(sub1, 16,
+                               [](const Queue::SignalBatch& batch) -> std::size_t {
+                                   assert(batch.size() == 2);
+                                   assert(batch[0].signals_skipped == 8);
+                                   assert(batch[1].signals_skipped == 0);
+                                   assert(batch.lost_signals() == 0);
+                                   return batch.size();
+                               });
+        assert(sub1.signals_skipped() == 13);
+
+        // Removed policy. Lag is kept.
+        assert(lag.set(sigfs_lag_t { .max_lag = 0, .keep = 0 }));
+        queue->set_lag(sub1, lag);
+
+        for(int ind = 0; ind < 10; ++ind)
+            queue->queue_signal("LA", 3);
+
+        queue->dequeue_signals(sub1, 16,
+                               [](const Queue::SignalBatch& batch) -> std::size_t {
+                                   assert(batch.size() == 10);
+                                   assert(batch[0].signals_skipped == 0);
+                                   return batch.size();
+                               });
+
+        SIGFS_LOG_INFO("PASS: 1.16");
+    }
+
+    {
+        // TEST 1.17
+        // Lossless flow control. Publishers wait for, or are
+        // rejected by, a full queue instead of overwriting signals.
+        //
+        SIGFS_LOG_DEBUG("START: 1.17");
+        Queue::Config cfg;
+
+        cfg.overflow = Queue::overflow_t::reject;
+
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(4, 0, cfg));
+
+        // No subscribers. Nothing to wait for.
+        for(int ind = 0; ind < 5; ++ind)
+            assert(g_queue->queue_signal("F0", 3));
+
+        Subscriber sub1(g_queue);
+
+        // The queue holds three signals.
+        assert(g_queue->queue_signal("F1", 3));
+        assert(g_queue->queue_signal("F2", 3));
+        assert(g_queue->queue_signal("F3", 3));
+        assert(!g_queue->queue_signal("F4", 3));
+        assert(g_queue->statistics().signals_rejected == 1);
+
+        check_signal(*g_queue, "1.17.1", sub1, "F1", 3, 0);
+        assert(g_queue->queue_signal("F5", 3));
+        assert(!g_queue->queue_signal("F6", 3));
+
+        check_signal(*g_queue, "1.17.2", sub1, "F2", 3, 0);
+        check_signal(*g_queue, "1.17.3", sub1, "F3", 3, 0);
+        check_signal(*g_queue, "1.17.4", sub1, "F5", 3, 0);
+        assert(!g_queue->signal_available(sub1));
+        assert(g_queue->statistics().signals_rejected == 2);
+
+        // Wait for a subscriber to read a signal.
+        cfg.overflow = Queue::overflow_t::block;
+        cfg.overflow_timeout = 10000000; // 10 msec
+
+        std::shared_ptr<Queue> b_queue(std::make_shared<Queue>(4, 0, cfg));
+        Subscriber sub2(b_queue);
+
+        assert(b_queue->queue_signal("B1", 3));
+        assert(b_queue->queue_signal("B2", 3));
+        assert(b_queue->queue_signal("B3", 3));
+
+        // Time out, or fail at once with nonblock set.
+        assert(!b_queue->queue_signal("B4", 3));
+        assert(!b_queue->queue_signal("B4", 3, true));
+
+        cfg.overflow_timeout = 10000000000; // 10 sec
+        std::shared_ptr<Queue> c_queue(std::make_shared<Queue>(4, 0, cfg));
+        Subscriber sub3(c_queue);
+
+        assert(c_queue->queue_signal("C1", 3));
+        assert(c_queue->queue_signal("C2", 3));
+        assert(c_queue->queue_signal("C3", 3));
+
+        std::thread sub_thr(
+            [&c_queue, &sub3]() {
+                usleep(10000);
+                check_signal(*c_queue, "1.17.5", sub3, "C1", 3, 0);
+            });
+
+        assert(c_queue->queue_signal("C4", 3));
+        sub_thr.join();
+
+        check_signal(*c_queue, "1.17.6", sub3, "C2", 3, 0);
+        check_signal(*c_queue, "1.17.7", sub3, "C3", 3, 0);
+        check_signal(*c_queue, "1.17.8", sub3, "C4", 3, 0);
+        assert(c_queue->statistics().signals_rejected == 0);
+
+        SIGFS_LOG_INFO("PASS: 1.17");
+    }
+
+    {
+        // TEST 1.18
+        // Write readiness. Writers are notified once subscribers
+        // have read signals from a full queue.
+        //
+        SIGFS_LOG_DEBUG("START: 1.18");
+        struct WriteNotified: public Subscriber {
+            WriteNotified(std::shared_ptr<Queue> queue):
+                Subscriber(queue, false),
+                notified(0)
+            {
+            }
+
+            virtual void queue_write_ready(void)
+            {
+                ++notified;
+            }
+
+            int notified;
+        };
+        Queue::Config cfg;
+
+        std::shared_ptr<Queue> o_queue(std::make_shared<Queue>(4, 0, cfg));
+        Subscriber sub1(o_queue);
+
+        // Overwrite mode is always ready.
+        for(int ind = 0; ind < 5; ++ind)
+            o_queue->queue_signal("W0", 3);
+
+        assert(o_queue->write_space_available());
+
+        cfg.overflow = Queue::overflow_t::reject;
+
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(4, 0, cfg));
+        Subscriber sub2(g_queue);
+        WriteNotified writer(g_queue);
+
+        g_queue->subscribe_write_ready_notifications(&writer);
+
+        assert(g_queue->write_space_available());
+        g_queue->queue_signal("W1", 3);
+        g_queue->queue_signal("W2", 3);
+        g_queue->queue_signal("W3", 3);
+        assert(!g_queue->write_space_available());
+        assert(writer.notified == 0);
+
+        check_signal(*g_queue, "1.18.1", sub2, "W1", 3, 0);
+        assert(writer.notified == 1);
+        assert(g_queue->write_space_available());
+
+        g_queue->unsubscribe_write_ready_notifications(&writer);
+        check_signal(*g_queue, "1.18.2", sub2, "W2", 3, 0);
+        assert(writer.notified == 1);
+
+        SIGFS_LOG_INFO("PASS: 1.18");
+    }
+
     //
     // THREADED TESTS
     //
@@ -490,9 +1397,19 @@ int main(int argc,  char *const* argv)
         //
         SIGFS_LOG_DEBUG("START: 2.0");
         std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(2048));
-
         Subscriber sub1(g_queue);
-        // // Create publisher thread A
+        const int prefixes[]= { 1, 2 };
+
+        // Create the subscriber thread ahead of the publishers, and
+        // check that all the combined 2400 signals can be read in
+        // sequence without loss by the single subscriber.
+        //
+        std::thread sub_thr (
+            [&sub1, &prefixes]() {
+                check_signal_sequence("2.0.3", sub1, prefixes, 2, 2400);
+            });
+
+        // Create publisher thread A
         std::thread pub_thr_a (
             [&g_queue]() {
                 publish_signal_sequence("2.0.1", *g_queue, 1, 1200);
@@ -506,20 +1423,14 @@ int main(int argc,  char *const* argv)
             });
 
 
-        // Create the subscriber and check that all the combined 2400
-        // signals can be read in sequence without loss by
-        // the single subscriber.
-        //
-        const int prefixes[]= { 1, 2 };
-        check_signal_sequence("2.0.3", sub1, prefixes, 2, 2400);
-
-        // Check that we got all signals and no more are ready to be read
-        assert(!g_queue->signal_available(sub1));
-
         // Join threads.
+        sub_thr.join();
         pub_thr_a.join();
         pub_thr_b.join();
 
+        // Check that we got all signals and no more are ready to be read
+        assert(!g_queue->signal_available(sub1));
+
         SIGFS_LOG_INFO("PASS: 2.0");
     }
 
@@ -569,6 +1480,47 @@ int main(int argc,  char *const* argv)
 
         SIGFS_LOG_INFO("PASS: 2.1");
     }
+
+    // TEST 2.2 - Two publishers, single subscriber, blocking publishers.
+    //
+    // Same as 2.0, but with publishers waiting for the subscriber
+    // instead of overwriting signals. Publish ten times the queue
+    // length, blocking the publishers whenever the subscriber falls
+    // behind.
+    {
+        SIGFS_LOG_DEBUG("START: 2.2");
+        Queue::Config cfg;
+
+        cfg.overflow = Queue::overflow_t::block;
+        cfg.overflow_timeout = 10000000000; // 10 sec
+        std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(2048, 0, cfg));
+        Subscriber sub1(g_queue);
+        const int prefixes[]= { 1, 2 };
+
+        std::thread sub_thr (
+            [&sub1, &prefixes]() {
+                check_signal_sequence("2.2.3", sub1, prefixes, 2, 20480);
+            });
+
+        std::thread pub_thr_a (
+            [&g_queue]() {
+                publish_signal_sequence("2.2.1", *g_queue, 1, 10240);
+            });
+
+        std::thread pub_thr_b (
+            [&g_queue]() {
+                publish_signal_sequence("2.2.2", *g_queue, 2, 10240);
+            });
+
+        sub_thr.join();
+        pub_thr_a.join();
+        pub_thr_b.join();
+
+        assert(!g_queue->signal_available(sub1));
+        assert(g_queue->statistics().signals_rejected == 0);
+
+        SIGFS_LOG_INFO("PASS: 2.2");
+    }
     printf("%s: Test internal queue integrity - passed\n", prog_name);
 
     exit(0);
@@ -27,8 +27,10 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <thread>
+#include <vector>
 
 int queue_length{131072};
+bool use_std_function{false};
 
 void usage(const char* name)
 {
@@ -36,14 +38,22 @@ void usage(const char* name)
     std::cout << "        [-s <number-of-subscribers> | --subscribers=<number-of-subscribers>]" << std::endl;
     std::cout << "        [-c <signal-count> | --count=<signal-count>]" << std::endl;
     std::cout << "        [-q <queue-length> | --queue-length=<queue-length>" << std::endl;
+    std::cout << "        [-P <bytes> | --payload-size=<bytes>]" << std::endl;
+    std::cout << "        [-j | --json]" << std::endl;
+    std::cout << "        [-F | --std-function]" << std::endl;
+    std::cout << "-P bytes  Number of bytes to send in each signal. Min: 8. Default: 8" << std::endl;
+    std::cout << "-j        Print the result as a single JSON object." << std::endl;
+    std::cout << "-F        Dequeue through the Queue::signal_callback_t (std::function)" << std::endl;
+    std::cout << "          overload instead of the inlinable template overload." << std::endl;
 }
 
 
 
-void publish_signal_sequence(std::shared_ptr<sigfs::Queue> queue, const int publish_id, int count)
+void publish_signal_sequence(std::shared_ptr<sigfs::Queue> queue, const int publish_id, int count, int payload_size)
 {
     int sig_id{0};
-    char buf[256];
+    std::vector<char> payload(payload_size);
+    char* buf(payload.data());
 
     SIGFS_LOG_DEBUG("Called. Publishing %d signals", count);
 
@@ -55,7 +65,7 @@ void publish_signal_sequence(std::shared_ptr<sigfs::Queue> queue, const int publ
                         *((int*) (buf + sizeof(int))),
                         publish_id, sig_id);
 
-        queue->queue_signal(buf, 2*sizeof(int));
+        queue->queue_signal(buf, payload_size);
     }
     SIGFS_LOG_DEBUG("Done. Published %d signals", count);
 }
@@ -73,6 +83,7 @@ void publish_signal_sequence(std::shared_ptr<sigfs::Queue> queue, const int publ
 // 'sub' is the subscriber that reads the signal sequence.
 // 'prefix' contains an array of pointers to signal prefixes ("A", "B", "thread-1", etc)
 // 'count' is the number of signals to expect (starting with signal 0).
+// 'latency' records the time from queue_signal() to the callback of each signal.
 //
 // Signals from each publisher are expected to have the format
 // <prefix_id (4 bytes)><sequence_id (4 bytes)>
@@ -82,19 +93,22 @@ void check_signal_sequence(std::shared_ptr<sigfs::Queue> queue,
                            sigfs::Subscriber* sub,
                            const int* prefix_ids,
                            int prefix_count,
-                           int count)
+                           int count,
+                           sigfs::Histogram* latency)
 {
     int expect_sigid[prefix_count] = {};
     int ind = 0;
 
-    sigfs::Queue::signal_callback_t<void*> cb =
-        [&expect_sigid, &count, sub, ind, prefix_count, prefix_ids]
-            (void* userdata,
-             signal_id_t signal_id,
+    auto cb =
+        [&expect_sigid, &count, sub, ind, prefix_count, prefix_ids, latency]
+            (signal_id_t signal_id,
              const char* payload,
              std::uint32_t payload_size,
              signal_count_t lost_signals,
-             signal_count_t remaining_signal_count) -> sigfs::Queue::cb_result_t {
+             signal_count_t remaining_signal_count,
+             std::uint64_t publish_time) -> sigfs::Queue::cb_result_t {
+
+            latency->record(sigfs::Queue::timestamp() - publish_time);
 
             // Did we lose signals?
             if (lost_signals > 0) {
@@ -151,8 +165,26 @@ void check_signal_sequence(std::shared_ptr<sigfs::Queue> queue,
             return sigfs::Queue::cb_result_t::processed_call_again;
         };
 
+    if (use_std_function) {
+        sigfs::Queue::signal_callback_t<void*> std_cb =
+            [&cb](void* userdata,
+                  signal_id_t signal_id,
+                  const char* payload,
+                  std::uint32_t payload_size,
+                  signal_count_t lost_signals,
+                  signal_count_t remaining_signal_count,
+                  std::uint64_t publish_time) -> sigfs::Queue::cb_result_t {
+                return cb(signal_id, payload, payload_size, lost_signals, remaining_signal_count, publish_time);
+            };
+
+        while(count)
+            queue->dequeue_signal<void*>(*sub, 0, std_cb);
+
+        return;
+    }
+
     while(count)
-        queue->dequeue_signal<void*>(*sub, 0, cb);
+        queue->dequeue_signal(*sub, cb);
 
 
     return;
@@ -168,14 +200,19 @@ int main(int argc,  char *const* argv)
         {"subscribers", optional_argument, NULL, 's'},
         {"count", required_argument, NULL, 'c'},
         {"queue-length", optional_argument, NULL, 'q'},
+        {"payload-size", required_argument, NULL, 'P'},
+        {"json", no_argument, NULL, 'j'},
+        {"std-function", no_argument, NULL, 'F'},
         {NULL, 0, NULL, 0}
     };
     int signal_count{1000000};
     int nr_publishers{1};
     int nr_subscribers{1};
+    int payload_size{8};
+    bool json{false};
 
     // loop over all of the options
-    while ((ch = getopt_long(argc, argv, "p:s:c:q:", long_options, NULL)) != -1) {
+    while ((ch = getopt_long(argc, argv, "p:s:c:q:P:jF", long_options, NULL)) != -1) {
         // check to see if a single character or long option came through
         switch (ch)
         {
@@ -195,6 +232,18 @@ int main(int argc,  char *const* argv)
             queue_length = std::atoi(optarg);
             break;
 
+        case 'P':
+            payload_size = std::atoi(optarg);
+            break;
+
+        case 'j':
+            json = true;
+            break;
+
+        case 'F':
+            use_std_function = true;
+            break;
+
         default:
             usage(argv[0]);
             exit(255);
@@ -210,14 +259,20 @@ int main(int argc,  char *const* argv)
         exit(255);
     }
 
+    if (payload_size < 8) {
+        printf("payload size must be at least 8 bytes.\n");
+        exit(255);
+    }
+
     sigfs_log_set_start_time();
 
     // TEST 1.0
     // One signal published. One signal read
     //
 
-    printf("queue-length: %d, nr-publishers: %d, nr-subscribers: %d, total-nr-signals: %d\n",
-           queue_length, nr_publishers, nr_subscribers, signal_count * nr_publishers);
+    if (!json)
+        printf("queue-length: %d, nr-publishers: %d, nr-subscribers: %d, total-nr-signals: %d\n",
+               queue_length, nr_publishers, nr_subscribers, signal_count * nr_publishers);
 
     std::shared_ptr<Queue> g_queue(std::make_shared<Queue>(queue_length));
 
@@ -225,6 +280,7 @@ int main(int argc,  char *const* argv)
     std::thread *sub_thr[nr_subscribers] = {};
     std::thread *pub_thr[nr_publishers] = {};
     int prefix_ids[nr_publishers];
+    std::vector<Histogram> latency(nr_subscribers);
 
     for (int i=0; i < nr_publishers; ++i) {
         prefix_ids[i] = i + 1;
@@ -235,14 +291,14 @@ int main(int argc,  char *const* argv)
     //
     for (int i=0; i < nr_subscribers; ++i) {
         subs[i] = new Subscriber(g_queue);
-        sub_thr[i] = new std::thread(check_signal_sequence, g_queue, subs[i], (int*) prefix_ids, nr_publishers, signal_count * nr_publishers);
+        sub_thr[i] = new std::thread(check_signal_sequence, g_queue, subs[i], (int*) prefix_ids, nr_publishers, signal_count * nr_publishers, &latency[i]);
     }
 
     //
     // Launch a bunch of publisher threads
     //
     for (int i=0; i < nr_publishers; ++i) {
-        pub_thr[i] = new std::thread (publish_signal_sequence, g_queue, i+1, signal_count);
+        pub_thr[i] = new std::thread (publish_signal_sequence, g_queue, i+1, signal_count, payload_size);
     }
 
 
@@ -256,6 +312,21 @@ int main(int argc,  char *const* argv)
     }
 
     auto done = sigfs_usec_since_start();
+
+    for (int i=1; i < nr_subscribers; ++i)
+        latency[0].add(latency[i]);
+
+    if (json) {
+        printf("{ \"test\": \"queue_speed\", \"queue_length\": %d, \"publishers\": %d, \"subscribers\": %d, "
+               "\"payload_size\": %d, \"callback\": \"%s\", \"signals\": %d, \"elapsed_usec\": %ld, \"signals_per_sec\": %.0f, "
+               "\"latency_p50_nsec\": %lu, \"latency_p99_nsec\": %lu, \"latency_max_nsec\": %lu }\n",
+               queue_length, nr_publishers, nr_subscribers, payload_size,
+               use_std_function?"std::function":"template", signal_count * nr_publishers, done,
+               (float) (signal_count*nr_publishers) / (float) (done / 1000000.0),
+               latency[0].percentile(50.0), latency[0].percentile(99.0), latency[0].max());
+        exit(0);
+    }
+
     printf("queue-length: %d, nr-publishers: %d, nr-subscribers: %d, signal-count: %d, execution-time: %ld usec, %.0f signals/sec, %f nsec/signal\n",
            queue_length, nr_publishers, nr_subscribers, signal_count * nr_publishers, done,
            (float) (signal_count*nr_publishers) / (float) (done / 1000000.0),